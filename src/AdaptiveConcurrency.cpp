@@ -0,0 +1,148 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+* MIT License
+*
+* Copyright (c) 2017 Simon Carter (s1cart3r@gmail.com)
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*
+* The Original Code was created by Simon Carter (s1cart3r@gmail.com).
+*
+* Module:  fbSMTPUDF - Firebird UDF Library for sending emails.
+*
+* Description: Adjusts the number of sessions sending to a server to suit
+*			   how quickly the server accepts messages.
+*
+* Date: 17/10/2026
+*
+*/
+
+
+#include "AdaptiveConcurrency.h"
+
+namespace FBMailUDF
+{
+	const double LATENCY_WEIGHT = 0.2;			// weight of each new latency in the moving average
+	const double BASELINE_DRIFT = 0.01;			// rate the normal latency rises towards the average
+	const double LATENCY_FACTOR = 2.0;			// average latency above this multiple of normal is too slow
+	const int DECREASE_INTERVAL_MS = 5000;		// the limit is halved at most once in this period
+
+	AdaptiveConcurrency::AdaptiveConcurrency()
+		: limit(INITIAL_SERVER_SESSIONS), maximum(DEFAULT_SERVER_MAX_SESSIONS), successCount(0), 
+		averageLatency(0), baselineLatency(0)
+	{
+
+	}
+
+	AdaptiveConcurrency::~AdaptiveConcurrency()
+	{
+
+	}
+
+	int AdaptiveConcurrency::getLimit()
+	{
+		return (limit);
+	}
+
+	int AdaptiveConcurrency::getMaximum()
+	{
+		return (maximum);
+	}
+
+	void AdaptiveConcurrency::setMaximum(const int value)
+	{
+		std::lock_guard<std::mutex> guard(concurrencyLock);
+
+		maximum = value;
+
+		if (limit > maximum)
+			limit = maximum.load();
+	}
+
+	void AdaptiveConcurrency::recordSuccess()
+	{
+		std::lock_guard<std::mutex> guard(concurrencyLock);
+
+		// one more session is allowed once every session has sent a message
+		if (++successCount >= limit)
+		{
+			successCount = 0;
+
+			if (limit < maximum)
+				limit++;
+		}
+	}
+
+	void AdaptiveConcurrency::recordSuccess(const std::chrono::microseconds &latency)
+	{
+		{
+			std::lock_guard<std::mutex> guard(concurrencyLock);
+
+			double sample = static_cast<double>(latency.count());
+
+			if (averageLatency == 0)
+				averageLatency = sample;
+			else
+				averageLatency += (sample - averageLatency) * LATENCY_WEIGHT;
+
+			// the normal latency follows the lowest average seen, rising slowly so a 
+			// server which is permanently slower is not treated as overloaded forever
+			if (baselineLatency == 0 || averageLatency < baselineLatency)
+				baselineLatency = averageLatency;
+			else
+				baselineLatency += (averageLatency - baselineLatency) * BASELINE_DRIFT;
+
+			if (averageLatency > baselineLatency * LATENCY_FACTOR)
+			{
+				decrease();
+				return;
+			}
+		}
+
+		recordSuccess();
+	}
+
+	void AdaptiveConcurrency::recordThrottled()
+	{
+		std::lock_guard<std::mutex> guard(concurrencyLock);
+		decrease();
+	}
+
+	bool AdaptiveConcurrency::isThrottleReply(const int replyCode)
+	{
+		// 421 service not available and 451 local error are used by relays to ask the
+		// sender to slow down
+		return (replyCode == 421 || replyCode == 451);
+	}
+
+	// private methods
+
+	void AdaptiveConcurrency::decrease()
+	{
+		// the caller must hold concurrencyLock, sessions already sending when the server
+		// slowed down all report it, so the limit is only halved once for them
+		std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+
+		if (now - lastDecrease < std::chrono::milliseconds(DECREASE_INTERVAL_MS))
+			return;
+
+		lastDecrease = now;
+		successCount = 0;
+		limit = limit > 1 ? limit / 2 : 1;
+	}
+}
@@ -0,0 +1,83 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+* MIT License
+*
+* Copyright (c) 2017 Simon Carter (s1cart3r@gmail.com)
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*
+* The Original Code was created by Simon Carter (s1cart3r@gmail.com).
+*
+* Module:  fbSMTPUDF - Firebird UDF Library for sending emails.
+*
+* Description: Adjusts the number of sessions sending to a server to suit
+*			   how quickly the server accepts messages.
+*
+* Date: 17/10/2026
+*
+*/
+
+
+#ifndef FB_SMTP__ADAPTIVE_CONCURRENCY
+#define FB_SMTP__ADAPTIVE_CONCURRENCY
+
+#include <mutex>
+#include <atomic>
+#include <chrono>
+
+#include "Global.h"
+
+namespace FBMailUDF
+{
+	// the session limit grows by one each time as many messages as there are sessions have 
+	// been sent without trouble, it is halved when the server replies asking the sender to
+	// slow down or the time it takes to reply to a command rises well above what is normal 
+	// for it, the size of the message does not affect the reply time
+	class AdaptiveConcurrency
+	{
+	private:
+		std::mutex concurrencyLock;
+		std::atomic<int> limit;
+		std::atomic<int> maximum;
+		int successCount;
+		double averageLatency;
+		double baselineLatency;
+		std::chrono::steady_clock::time_point lastDecrease;
+
+		void decrease();
+
+		// prevent class copying
+		AdaptiveConcurrency(const AdaptiveConcurrency&);
+		AdaptiveConcurrency& operator=(const AdaptiveConcurrency&);
+	public:
+		AdaptiveConcurrency();
+		~AdaptiveConcurrency();
+
+		int getLimit();
+		int getMaximum();
+		void setMaximum(const int value);
+
+		void recordSuccess();
+		void recordSuccess(const std::chrono::microseconds &latency);
+		void recordThrottled();
+
+		static bool isThrottleReply(const int replyCode);
+	};
+}
+
+#endif
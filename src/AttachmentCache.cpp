@@ -0,0 +1,179 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+* MIT License
+*
+* Copyright (c) 2017 Simon Carter (s1cart3r@gmail.com)
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*
+* The Original Code was created by Simon Carter (s1cart3r@gmail.com).
+*
+* Module:  fbSMTPUDF - Firebird UDF Library for sending emails.
+*
+* Description: Cache of base64 encoded attachments shared by every message.
+*
+* Date: 17/10/2026
+*
+*/
+
+
+#include <list>
+#include <unordered_map>
+#include <mutex>
+#include <atomic>
+
+#include "AttachmentCache.h"
+
+namespace FBMailUDF
+{
+	struct CachedAttachment
+	{
+		std::string key;
+		EncodedAttachment encoded;
+	};
+
+	typedef std::list<CachedAttachment> CachedAttachmentList;
+
+	typedef std::unordered_map<std::string, CachedAttachmentList::iterator> CachedAttachmentIndex;
+
+	// the cached attachments are created on first use and never destroyed, a send thread
+	// still finishing a message when the library is unloaded can look up or add an attachment
+	static std::mutex& attachmentCacheMutex()
+	{
+		static std::mutex *Result = new std::mutex();
+		return (*Result);
+	}
+
+	// most recently sent first
+	static CachedAttachmentList& cachedAttachments()
+	{
+		static CachedAttachmentList *Result = new CachedAttachmentList();
+		return (*Result);
+	}
+
+	static CachedAttachmentIndex& cachedAttachmentIndex()
+	{
+		static CachedAttachmentIndex *Result = new CachedAttachmentIndex();
+		return (*Result);
+	}
+
+	size_t cachedAttachmentBytes = 0;
+
+	std::atomic<size_t> attachmentCacheSize(static_cast<size_t>(DEFAULT_ATTACHMENT_CACHE_SIZE) * 1024 * 1024);
+	std::atomic<FB_BIGINT> attachmentCacheHits(0);
+	std::atomic<FB_BIGINT> attachmentCacheMisses(0);
+	std::atomic<FB_BIGINT> attachmentCacheBytesSaved(0);
+
+	// removes the least recently sent attachments until the cache fits in its size,
+	// messages still sending a removed attachment keep their reference to it
+	void trimAttachmentCache(const size_t cacheSize)
+	{
+		while (cachedAttachmentBytes > cacheSize && !cachedAttachments().empty())
+		{
+			cachedAttachmentBytes -= cachedAttachments().back().encoded->size();
+			cachedAttachmentIndex().erase(cachedAttachments().back().key);
+			cachedAttachments().pop_back();
+		}
+	}
+
+	EMailResult AttachmentCache::setCacheSize(const int value)
+	{
+		if (value < 0 || value > MAX_ATTACHMENT_CACHE_SIZE)
+			return (EMailResult::InvalidOptionValue);
+
+		std::lock_guard<std::mutex> guard(attachmentCacheMutex());
+
+		attachmentCacheSize = static_cast<size_t>(value) * 1024 * 1024;
+		trimAttachmentCache(attachmentCacheSize);
+
+		return (EMailResult::Success);
+	}
+
+	EncodedAttachment AttachmentCache::Find(const std::string &key)
+	{
+		if (attachmentCacheSize == 0)
+			return (nullptr);
+
+		std::lock_guard<std::mutex> guard(attachmentCacheMutex());
+
+		auto entry = cachedAttachmentIndex().find(key);
+
+		if (entry == cachedAttachmentIndex().end())
+		{
+			attachmentCacheMisses++;
+			return (nullptr);
+		}
+
+		cachedAttachments().splice(cachedAttachments().begin(), cachedAttachments(), entry->second);
+
+		attachmentCacheHits++;
+		attachmentCacheBytesSaved += entry->second->encoded->size();
+
+		return (entry->second->encoded);
+	}
+
+	bool AttachmentCache::CanCache(size_t encodedSize)
+	{
+		size_t cacheSize = attachmentCacheSize;
+
+		// a file larger than a quarter of the cache would remove too many others, it is
+		// encoded as it is sent instead
+		return (cacheSize > 0 && encodedSize <= cacheSize / 4);
+	}
+
+	void AttachmentCache::Add(const std::string &key, const EncodedAttachment &encoded)
+	{
+		std::lock_guard<std::mutex> guard(attachmentCacheMutex());
+
+		// another message may have encoded the same file at the same time
+		if (cachedAttachmentIndex().find(key) != cachedAttachmentIndex().end())
+			return;
+
+		cachedAttachments().push_front({ key, encoded });
+		cachedAttachmentIndex()[key] = cachedAttachments().begin();
+		cachedAttachmentBytes += encoded->size();
+
+		trimAttachmentCache(attachmentCacheSize);
+	}
+
+	FB_BIGINT AttachmentCache::getHits()
+	{
+		return (attachmentCacheHits);
+	}
+
+	FB_BIGINT AttachmentCache::getMisses()
+	{
+		return (attachmentCacheMisses);
+	}
+
+	FB_BIGINT AttachmentCache::getHitRate()
+	{
+		FB_BIGINT hits = attachmentCacheHits;
+		FB_BIGINT total = hits + attachmentCacheMisses;
+
+		if (total == 0)
+			return (0);
+
+		return (hits * 100 / total);
+	}
+
+	FB_BIGINT AttachmentCache::getBytesSaved()
+	{
+		return (attachmentCacheBytesSaved);
+	}
+}
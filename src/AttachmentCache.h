@@ -0,0 +1,74 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+* MIT License
+*
+* Copyright (c) 2017 Simon Carter (s1cart3r@gmail.com)
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*
+* The Original Code was created by Simon Carter (s1cart3r@gmail.com).
+*
+* Module:  fbSMTPUDF - Firebird UDF Library for sending emails.
+*
+* Description: Cache of base64 encoded attachments shared by every message.
+*
+* Date: 17/10/2026
+*
+*/
+
+
+#ifndef FB_SMTP__ATTACHMENT_CACHE
+#define FB_SMTP__ATTACHMENT_CACHE
+
+#include <string>
+#include <memory>
+
+#include "Global.h"
+#include "CSmtp.h"
+
+namespace FBMailUDF
+{
+	typedef std::shared_ptr<const std::string> EncodedAttachment;
+
+	// attachments are kept encoded, with their MIME line breaks, so a file sent to many 
+	// recipients is only read and encoded once, a file is found by its name, size and 
+	// modification time so a file which changes is encoded again, the least recently 
+	// sent files are removed once the cache size is exceeded
+	//
+	// the contents are not compared, a file rewritten with the same size within the 
+	// resolution of its modification time (2 seconds on FAT, often a second or more 
+	// on network shares) is sent from the cache as it was before it was rewritten
+	//
+	// every instance shares the one cache, an instance is given to each session
+	class AttachmentCache : public CSmtpAttachmentCache
+	{
+	public:
+		static EMailResult setCacheSize(const int value);
+
+		EncodedAttachment Find(const std::string &key);
+		bool CanCache(size_t encodedSize);
+		void Add(const std::string &key, const EncodedAttachment &encoded);
+
+		static FB_BIGINT getHits();
+		static FB_BIGINT getMisses();
+		static FB_BIGINT getHitRate();
+		static FB_BIGINT getBytesSaved();
+	};
+}
+
+#endif
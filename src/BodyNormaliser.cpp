@@ -0,0 +1,183 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+* MIT License
+*
+* Copyright (c) 2017 Simon Carter (s1cart3r@gmail.com)
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*
+* The Original Code was created by Simon Carter (s1cart3r@gmail.com).
+*
+* Module:  fbSMTPUDF - Firebird UDF Library for sending emails.
+*
+* Description: Converts a message body in to the bytes sent after DATA.
+*
+* Date: 17/10/2026
+*
+*/
+
+
+#include "BodyNormaliser.h"
+
+#ifdef FB_SMTP_X86
+	#include <immintrin.h>
+
+	#ifdef _MSC_VER
+		#include <intrin.h>
+	#endif
+#endif
+
+namespace FBMailUDF
+{
+	const size_t MAX_LINE_LENGTH = 998;		// octets in a line, not including the CRLF
+
+	size_t findLineBreakScalar(const char *data, const size_t size)
+	{
+		for (size_t i = 0; i < size; i++)
+		{
+			if (data[i] == '\r' || data[i] == '\n')
+				return (i);
+		}
+
+		return (size);
+	}
+
+#ifdef FB_SMTP_X86
+	inline size_t lowestBit(const unsigned int mask)
+	{
+#ifdef _MSC_VER
+		unsigned long Result;
+		_BitScanForward(&Result, mask);
+		return (Result);
+#else
+		return (__builtin_ctz(mask));
+#endif
+	}
+
+	FB_SMTP_TARGET("sse2")
+	size_t findLineBreakSSE2(const char *data, const size_t size)
+	{
+		const __m128i cr = _mm_set1_epi8('\r');
+		const __m128i lf = _mm_set1_epi8('\n');
+		size_t i = 0;
+
+		for (; i + 16 <= size; i += 16)
+		{
+			__m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+			unsigned int mask = static_cast<unsigned int>(_mm_movemask_epi8(
+				_mm_or_si128(_mm_cmpeq_epi8(block, cr), _mm_cmpeq_epi8(block, lf))));
+
+			if (mask != 0)
+				return (i + lowestBit(mask));
+		}
+
+		return (i + findLineBreakScalar(data + i, size - i));
+	}
+
+	FB_SMTP_TARGET("avx2")
+	size_t findLineBreakAVX2(const char *data, const size_t size)
+	{
+		const __m256i cr = _mm256_set1_epi8('\r');
+		const __m256i lf = _mm256_set1_epi8('\n');
+		size_t i = 0;
+
+		for (; i + 32 <= size; i += 32)
+		{
+			__m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i));
+			unsigned int mask = static_cast<unsigned int>(_mm256_movemask_epi8(
+				_mm256_or_si256(_mm256_cmpeq_epi8(block, cr), _mm256_cmpeq_epi8(block, lf))));
+
+			if (mask != 0)
+				return (i + lowestBit(mask));
+		}
+
+		return (i + findLineBreakSSE2(data + i, size - i));
+	}
+#endif
+
+	BodyNormaliser::FindLineBreak BodyNormaliser::getFindLineBreak()
+	{
+#ifdef FB_SMTP_X86
+		if (CpuFeatures::hasAVX2())
+			return (findLineBreakAVX2);
+
+		if (CpuFeatures::hasSSE2())
+			return (findLineBreakSSE2);
+#endif
+		return (findLineBreakScalar);
+	}
+
+	void BodyNormaliser::normalise(const char *data, const size_t size, std::string &output)
+	{
+		static const FindLineBreak findLineBreak = getFindLineBreak();
+
+		output.clear();
+		output.reserve(size + (size / 32) + 2);
+
+		size_t pos = 0;
+		size_t lineLength = 0;
+
+		while (pos < size)
+		{
+			size_t run = findLineBreak(data + pos, size - pos);
+
+			// the text up to the line break is copied in one go, unless the line has to be
+			// wrapped, a line starting with a dot has another dot added in front of it
+			while (run > 0)
+			{
+				if (lineLength == 0 && data[pos] == '.')
+				{
+					output.push_back('.');
+					lineLength++;
+				}
+
+				size_t part = MAX_LINE_LENGTH - lineLength;
+
+				if (part > run)
+					part = run;
+
+				output.append(data + pos, part);
+				pos += part;
+				run -= part;
+				lineLength += part;
+
+				if (lineLength == MAX_LINE_LENGTH && run > 0)
+				{
+					output.append("\r\n", 2);
+					lineLength = 0;
+				}
+			}
+
+			if (pos >= size)
+				break;
+
+			// CRLF, a bare CR or a bare LF all end the line with CRLF
+			if (data[pos] == '\r' && pos + 1 < size && data[pos + 1] == '\n')
+				pos += 2;
+			else
+				pos++;
+
+			output.append("\r\n", 2);
+			lineLength = 0;
+		}
+
+		// the body always ends with a line break before the terminating dot
+		if (lineLength > 0 || output.empty())
+			output.append("\r\n", 2);
+	}
+}
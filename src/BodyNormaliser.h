@@ -0,0 +1,60 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+* MIT License
+*
+* Copyright (c) 2017 Simon Carter (s1cart3r@gmail.com)
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*
+* The Original Code was created by Simon Carter (s1cart3r@gmail.com).
+*
+* Module:  fbSMTPUDF - Firebird UDF Library for sending emails.
+*
+* Description: Converts a message body in to the bytes sent after DATA.
+*
+* Date: 17/10/2026
+*
+*/
+
+
+#ifndef FB_SMTP__BODY_NORMALISER
+#define FB_SMTP__BODY_NORMALISER
+
+#include <string>
+
+#include "Global.h"
+#include "CpuFeatures.h"
+
+namespace FBMailUDF
+{
+	// in one pass over the body, bare CR or LF line breaks become CRLF, lines starting 
+	// with a dot are dot stuffed (RFC 5321 4.5.2) and lines longer than 998 octets are 
+	// wrapped (RFC 5321 4.5.3.1.6).  Line breaks are found 32 bytes at a time with AVX2,
+	// 16 at a time with SSE2 or a byte at a time if neither is available
+	class BodyNormaliser
+	{
+	private:
+		typedef size_t(*FindLineBreak)(const char *data, const size_t size);
+
+		static FindLineBreak getFindLineBreak();
+	public:
+		static void normalise(const char *data, const size_t size, std::string &output);
+	};
+}
+
+#endif
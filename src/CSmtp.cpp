@@ -96,7 +96,17 @@
 #include "base64.h"
 #include "openssl\err.h"
 
+#ifdef LINUX
+#include <sys/stat.h>
+#include <fcntl.h>
+#endif
+
 #include <cassert>
+#include <cstdint>
+#include <mutex>
+#include <atomic>
+#include <map>
+#include <chrono>
 
 #ifndef LINUX
 #pragma comment(lib, "libssl.lib")
@@ -128,9 +138,133 @@ Command_Entry command_list[] =
 	{command_DATABLOCK,     3*60,  0,     0,   ECSmtp::COMMAND_DATABLOCK},	// Here the valid_reply_code is set to zero because there are no replies when sending data blocks
 	{command_DATAEND,       3*60,  10*60, 250, ECSmtp::MSG_BODY_ERROR},
 	{command_QUIT,          5*60,  5*60,  221, ECSmtp::COMMAND_QUIT},
-	{command_STARTTLS,      5*60,  5*60,  220, ECSmtp::COMMAND_EHLO_STARTTLS}
+	{command_STARTTLS,      5*60,  5*60,  220, ECSmtp::COMMAND_EHLO_STARTTLS},
+	{command_RSET,          5*60,  5*60,  250, ECSmtp::COMMAND_RSET}
 };
 
+// OpenSSL is initialised once per process, every connection using the same
+// security type shares one SSL_CTX (SSL_CTX is thread safe once created)
+std::once_flag openSSLInitialised;
+SSL_CTX* sslContexts[DO_NOT_SET] = { NULL };
+
+// the locks, session cache and host name are created on first use and never
+// destroyed, a send thread still connecting when the library is unloaded can
+// use them after static objects have been destroyed
+static std::mutex& sslContextLock()
+{
+	static std::mutex *Result = new std::mutex();
+	return (*Result);
+}
+
+// TLS sessions are remembered per server and offered on the next connection so
+// the handshake can be resumed instead of repeated in full
+static std::mutex& sslSessionLock()
+{
+	static std::mutex *Result = new std::mutex();
+	return (*Result);
+}
+
+static std::map<std::string, SSL_SESSION*>& sslSessions()
+{
+	static std::map<std::string, SSL_SESSION*> *Result = new std::map<std::string, SSL_SESSION*>();
+	return (*Result);
+}
+
+std::atomic<unsigned long long> fullHandshakes(0);
+std::atomic<unsigned long long> resumedHandshakes(0);
+
+// called by OpenSSL when the server issues a session (or a TLS 1.3 ticket),
+// the app data of the connection holds the cache key for the server
+int StoreTlsSession(SSL *ssl, SSL_SESSION *session)
+{
+	const std::string *key = static_cast<const std::string*>(SSL_get_app_data(ssl));
+
+	if(key == NULL || key->empty() || !SSL_SESSION_is_resumable(session))
+		return (0);
+
+	std::lock_guard<std::mutex> guard(sslSessionLock());
+	std::map<std::string, SSL_SESSION*>::iterator it = sslSessions().find(*key);
+
+	if(it != sslSessions().end())
+	{
+		SSL_SESSION_free(it->second);
+		it->second = session;
+	}
+	else
+		sslSessions()[*key] = session;
+
+	// returning 1 keeps the reference OpenSSL passed to us
+	return (1);
+}
+
+SSL_SESSION* FindTlsSession(const std::string &key)
+{
+	std::lock_guard<std::mutex> guard(sslSessionLock());
+	std::map<std::string, SSL_SESSION*>::iterator it = sslSessions().find(key);
+
+	if(it == sslSessions().end())
+		return (NULL);
+
+	SSL_SESSION_up_ref(it->second);
+	return (it->second);
+}
+
+void RemoveTlsSession(const std::string &key)
+{
+	std::lock_guard<std::mutex> guard(sslSessionLock());
+	std::map<std::string, SSL_SESSION*>::iterator it = sslSessions().find(key);
+
+	if(it != sslSessions().end())
+	{
+		SSL_SESSION_free(it->second);
+		sslSessions().erase(it);
+	}
+}
+
+// the local host name does not change, it is looked up by the first instance only
+std::once_flag localHostNameFound;
+
+static std::string& localHostName()
+{
+	static std::string *Result = new std::string();
+	return (*Result);
+}
+
+void InitialiseOpenSSLLibrary()
+{
+	SSL_library_init();
+	SSL_load_error_strings();
+}
+
+SSL_CTX* GetSharedSSLContext(SMTP_SECURITY_TYPE type)
+{
+	std::call_once(openSSLInitialised, InitialiseOpenSSLLibrary);
+
+	std::lock_guard<std::mutex> guard(sslContextLock());
+
+	if(sslContexts[type] == NULL)
+	{
+		sslContexts[type] = SSL_CTX_new(SSLv23_client_method());
+
+		if(sslContexts[type] != NULL)
+		{
+			// sessions are stored in our own per server cache, not the context
+			SSL_CTX_set_session_cache_mode(sslContexts[type],
+				SSL_SESS_CACHE_CLIENT | SSL_SESS_CACHE_NO_INTERNAL_STORE);
+			SSL_CTX_sess_set_new_cb(sslContexts[type], StoreTlsSession);
+		}
+	}
+
+	return sslContexts[type];
+}
+
+void FindLocalHostName()
+{
+	char hostname[255];
+	if(gethostname((char *) &hostname, 255) == SOCKET_ERROR) throw ECSmtp(ECSmtp::WSA_HOSTNAME);
+	localHostName() = hostname;
+}
+
 Command_Entry* FindCommandEntry(SMTP_COMMAND command)
 {
 	Command_Entry* pEntry = NULL;
@@ -188,6 +322,48 @@ bool IsKeywordSupported(const char* response, const char* keyword)
 	return false;
 }
 
+// Finds the end of the first complete (possibly multi-line) reply in line
+bool FindReplyEnd(const std::string& line, size_t& end, int& reply_code)
+{
+	size_t len = line.length();
+	size_t begin = 0;
+	size_t offset = 0;
+
+	while(1) // loop for all lines
+	{
+		while(offset + 1 < len)
+		{
+			if(line[offset] == '\r' && line[offset+1] == '\n')
+				break;
+			++offset;
+		}
+		if(offset + 1 < len) // we found a line
+		{
+			// see if this is the last line
+			// the last line must match the pattern: XYZ<SP>*<CRLF> or XYZ<CRLF> where XYZ is a string of 3 digits 
+			offset += 2; // skip <CRLF>
+			if(offset - begin >= 5)
+			{
+				if(isdigit(line[begin]) && isdigit(line[begin+1]) && isdigit(line[begin+2]))
+				{
+					// this is the last line
+					if(offset - begin == 5 || line[begin+3] == ' ')
+					{
+						reply_code = (line[begin]-'0')*100 + (line[begin+1]-'0')*10 + line[begin+2]-'0';
+						end = offset;
+						return true;
+					}
+				}
+			}
+			begin = offset;	// try to find next line
+		}
+		else // we haven't received the last line, so we need to receive more data 
+		{
+			return false;
+		}
+	}
+}
+
 unsigned char* CharToUnsignedChar(const char *strIn)
 {
 	unsigned char *strOut;
@@ -223,6 +399,10 @@ CSmtp::CSmtp()
 {
 	hSocket = INVALID_SOCKET;
 	m_bConnected = false;
+	m_bPipelining = false;
+	m_iReplyLatency = 0;
+	m_iGatherBytes = 0;
+	m_pAttachmentCache = NULL;
 	m_iXPriority = XPRIORITY_NORMAL;
 	m_iSMTPSrvPort = 0;
 	m_bAuthenticate = true;
@@ -240,9 +420,8 @@ CSmtp::CSmtp()
 	}
 #endif
 
-	char hostname[255];
-	if(gethostname((char *) &hostname, 255) == SOCKET_ERROR) throw ECSmtp(ECSmtp::WSA_HOSTNAME);
-	m_sLocalHostName = hostname;
+	std::call_once(localHostNameFound, FindLocalHostName);
+	m_sLocalHostName = localHostName();
 	
 	if((RecvBuf = new char[BUFFER_SIZE]) == NULL)
 		throw ECSmtp(ECSmtp::LACK_OF_MEMORY);
@@ -272,7 +451,7 @@ CSmtp::CSmtp()
 ////////////////////////////////////////////////////////////////////////////////
 CSmtp::~CSmtp()
 {
-	if(m_bConnected) DisconnectRemoteServer();
+	if(hSocket != INVALID_SOCKET) DisconnectRemoteServer();
 
 	if(SendBuf)
 	{
@@ -400,6 +579,22 @@ void CSmtp::AddMsgLine(const char* Text)
 	MsgBody.insert(MsgBody.end(), Text);
 }
 
+////////////////////////////////////////////////////////////////////////////////
+//        NAME: SetMsgBody
+// DESCRIPTION: Sets the whole message body in the form it is sent after DATA,
+//              lines must end with CRLF and be dot stuffed.  When set the
+//              body is sent in place of the message lines. The body is
+//              moved in rather than copied.
+//   ARGUMENTS: std::string &&body - body to send
+// USES GLOBAL: m_sMsgBody
+// MODIFIES GL: m_sMsgBody
+//     RETURNS: void
+////////////////////////////////////////////////////////////////////////////////
+void CSmtp::SetMsgBody(std::string &&body)
+{
+	m_sMsgBody = std::move(body);
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 //        NAME: DelMsgLine
 // DESCRIPTION: Deletes specified line in text message.. .
@@ -479,6 +674,8 @@ void CSmtp::DelCCRecipients()
 void CSmtp::DelMsgLines()
 {
 	MsgBody.clear();
+	// the memory is released, a pooled session does not keep the largest body it has sent
+	std::string().swap(m_sMsgBody);
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -535,6 +732,84 @@ void CSmtp::ClearMessage()
 	DelMsgLines();
 }
 
+////////////////////////////////////////////////////////////////////////////////
+//        NAME: Reset
+// DESCRIPTION: Aborts the current mail transaction (RSET) so that the
+//              connection can be reused for another message.
+//   ARGUMENTS: none
+// USES GLOBAL: SendBuf, RecvBuf
+// MODIFIES GL: SendBuf, RecvBuf
+//     RETURNS: void
+////////////////////////////////////////////////////////////////////////////////
+void CSmtp::Reset()
+{
+	if(!IsConnected())
+		throw ECSmtp(ECSmtp::CONNECTION_CLOSED);
+
+	// an idle session the server has closed, or sent a 421 on, is not used
+	if(IsSessionStale())
+	{
+		CloseSocket();
+		throw ECSmtp(ECSmtp::CONNECTION_CLOSED);
+	}
+
+	try
+	{
+		Command_Entry* pEntry = FindCommandEntry(command_RSET);
+		// RSET <CRLF>
+		snprintf(SendBuf, BUFFER_SIZE, "RSET\r\n");
+		SendData(pEntry);
+		ReceiveResponse(pEntry);
+	}
+	catch(const ECSmtp&)
+	{
+		// the session has failed, QUIT would only wait for the server to time out
+		CloseSocket();
+		throw;
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//        NAME: IsSessionStale
+// DESCRIPTION: Checks, without waiting, whether anything has arrived on an
+//              idle session. Between transactions the server sends nothing
+//              unless it is closing the connection, so anything readable,
+//              including the end of the stream or an error, means the
+//              session can not be reused.
+//   ARGUMENTS: none
+// USES GLOBAL: hSocket, m_sRecvPending
+// MODIFIES GL: none
+//     RETURNS: true if the session can not be reused, otherwise false
+////////////////////////////////////////////////////////////////////////////////
+bool CSmtp::IsSessionStale()
+{
+	if(!m_sRecvPending.empty())
+		return true;
+
+	fd_set fdread;
+	timeval time;
+	time.tv_sec = 0;
+	time.tv_usec = 0;
+
+	FD_ZERO(&fdread);
+	FD_SET(hSocket,&fdread);
+
+	return select(hSocket+1, &fdread, NULL, NULL, &time) != 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//        NAME: IsConnected
+// DESCRIPTION: Indicates whether there is an open session with the server.
+//   ARGUMENTS: none
+// USES GLOBAL: hSocket, m_bConnected
+// MODIFIES GL: none
+//     RETURNS: true if connected, otherwise false
+////////////////////////////////////////////////////////////////////////////////
+bool CSmtp::IsConnected() const
+{
+	return hSocket != INVALID_SOCKET && m_bConnected;
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 //        NAME: Send
 // DESCRIPTION: Sending the mail. .
@@ -550,11 +825,14 @@ void CSmtp::ClearMessage()
 ////////////////////////////////////////////////////////////////////////////////
 void CSmtp::Send()
 {
-	unsigned int i,rcpt_count,res,FileId;
-	char *FileBuf = NULL;
-	FILE* hFile = NULL;
-	unsigned long int FileSize,TotalSize,MsgPart;
-	string FileName,EncodedFileName;
+	unsigned int i,rcpt_count,FileId;
+	char *EncodeBuf = NULL;
+	unsigned char *ReadBuf = NULL;
+	std::vector<AttachmentFile> AttachmentFiles;
+	bool bInData = false;
+	size_t FileSize,TotalSize,MsgPart,res;
+	string FileName,EncodedFileName,CacheKey;
+	std::shared_ptr<const std::string> Encoded;
 	string::size_type pos;
 
 	// ***** CONNECTING TO SMTP SERVER *****
@@ -567,91 +845,127 @@ void CSmtp::Send()
 	}
 
 	try{
-		//Allocate memory
-		if((FileBuf = new char[55]) == NULL)
-			throw ECSmtp(ECSmtp::LACK_OF_MEMORY);
+		//Allocate memory, only needed to encode attachments
+		if(Attachments.size())
+		{
+			if((EncodeBuf = new char[base64_encoded_size(ATTACHMENT_BLOCK, BASE64_MIME_LINE_LENGTH)]) == NULL)
+				throw ECSmtp(ECSmtp::LACK_OF_MEMORY);
+#ifdef LINUX
+			if((ReadBuf = new unsigned char[ATTACHMENT_BLOCK]) == NULL)
+				throw ECSmtp(ECSmtp::LACK_OF_MEMORY);
+#endif
+		}
 
-		//Check that any attachments specified can be opened
+		//Check that any attachments specified can be opened, each file is opened
+		//once and kept open until the file has been sent
 		TotalSize = 0;
+		AttachmentFiles.resize(Attachments.size());
 		for(FileId=0;FileId<Attachments.size();FileId++)
 		{
 			// opening the file:
-			hFile = fopen(Attachments[FileId].c_str(), "rb");
-			if(hFile == NULL)
+			if(!OpenAttachment(Attachments[FileId], AttachmentFiles[FileId]))
 				throw ECSmtp(ECSmtp::FILE_NOT_EXIST);
 			
 			// checking file size:
-			fseek(hFile, 0, SEEK_END);
-			FileSize = ftell(hFile);
-			TotalSize += FileSize;
+			TotalSize += AttachmentFiles[FileId].Size;
 
 			// sending the file:
 			if(TotalSize/1024 > MSG_SIZE_IN_MB*1024)
 				throw ECSmtp(ECSmtp::MSG_TOO_BIG);
-
-			fclose(hFile);
-			hFile=NULL;
 		}
 
 		// ***** SENDING E-MAIL *****
 		
-		// MAIL <SP> FROM:<reverse-path> <CRLF>
 		if(!m_sMailFrom.size())
 			throw ECSmtp(ECSmtp::UNDEF_MAIL_FROM);
-		Command_Entry* pEntry = FindCommandEntry(command_MAILFROM);
-		snprintf(SendBuf, BUFFER_SIZE, "MAIL FROM:<%s>\r\n", m_sMailFrom.c_str());
-		SendData(pEntry);
-		ReceiveResponse(pEntry);
-
-		// RCPT <SP> TO:<forward-path> <CRLF>
-		if(!(rcpt_count = Recipients.size()))
+		// recipients sharing a transaction are only sent as bcc recipients
+		if(!(rcpt_count = Recipients.size() + BCCRecipients.size()))
 			throw ECSmtp(ECSmtp::UNDEF_RECIPIENTS);
-		pEntry = FindCommandEntry(command_RCPTTO);
-		for(i=0;i<Recipients.size();i++)
+
+		RejectedRecipients.clear();
+		m_iReplyLatency = 0;
+
+		Command_Entry* pEntry;
+
+		if(m_bPipelining)
 		{
-			snprintf(SendBuf, BUFFER_SIZE, "RCPT TO:<%s>\r\n", (Recipients.at(i).Mail).c_str());
-			SendData(pEntry);
-			ReceiveResponse(pEntry);
+			// MAIL, RCPT and DATA sent as one batch (RFC 2920)
+			SendEnvelopePipelined();
 		}
-
-		for(i=0;i<CCRecipients.size();i++)
+		else
 		{
-			snprintf(SendBuf, BUFFER_SIZE, "RCPT TO:<%s>\r\n", (CCRecipients.at(i).Mail).c_str());
+			// MAIL <SP> FROM:<reverse-path> <CRLF>
+			pEntry = FindCommandEntry(command_MAILFROM);
+			snprintf(SendBuf, BUFFER_SIZE, "MAIL FROM:<%s>\r\n", m_sMailFrom.c_str());
+			std::chrono::steady_clock::time_point sent = std::chrono::steady_clock::now();
 			SendData(pEntry);
 			ReceiveResponse(pEntry);
-		}
+			m_iReplyLatency = static_cast<unsigned long>(std::chrono::duration_cast<std::chrono::microseconds>(
+				std::chrono::steady_clock::now() - sent).count());
+
+			// RCPT <SP> TO:<forward-path> <CRLF>
+			// as with pipelining, a rejected recipient is added to RejectedRecipients
+			// and the message is sent as long as one recipient is accepted
+			std::vector<const Recipient*> envelope;
+			for(i=0;i<Recipients.size();i++)
+				envelope.push_back(&Recipients.at(i));
+			for(i=0;i<CCRecipients.size();i++)
+				envelope.push_back(&CCRecipients.at(i));
+			for(i=0;i<BCCRecipients.size();i++)
+				envelope.push_back(&BCCRecipients.at(i));
+
+			unsigned int accepted = 0;
+			int rcpt_reply = 0;
+			pEntry = FindCommandEntry(command_RCPTTO);
+			for(i=0;i<envelope.size();i++)
+			{
+				snprintf(SendBuf, BUFFER_SIZE, "RCPT TO:<%s>\r\n", (envelope[i]->Mail).c_str());
+				SendData(pEntry);
+				rcpt_reply = ReadReply(pEntry);
+				if(rcpt_reply == pEntry->valid_reply_code)
+					accepted++;
+				else
+					RejectedRecipients.push_back(envelope[i]->Mail);
+			}
 
-		for(i=0;i<BCCRecipients.size();i++)
-		{
-			snprintf(SendBuf, BUFFER_SIZE, "RCPT TO:<%s>\r\n", (BCCRecipients.at(i).Mail).c_str());
+			if(accepted == 0)
+				throw ECSmtp(ECSmtp::COMMAND_RCPT_TO, rcpt_reply);
+			
+			pEntry = FindCommandEntry(command_DATA);
+			// DATA <CRLF>
+			snprintf(SendBuf, BUFFER_SIZE, "DATA\r\n");
 			SendData(pEntry);
 			ReceiveResponse(pEntry);
 		}
 		
-		pEntry = FindCommandEntry(command_DATA);
-		// DATA <CRLF>
-		snprintf(SendBuf, BUFFER_SIZE, "DATA\r\n");
-		SendData(pEntry);
-		ReceiveResponse(pEntry);
-		
+		// from here on the server is reading the message, an error part way through
+		// can only be recovered from by closing the connection
+		bInData = true;
+
 		pEntry = FindCommandEntry(command_DATABLOCK);
-		// send header(s)
+		// the header and message are gathered and sent in large blocks rather
+		// than a line at a time, message lines are not copied and any length
+		// of line is sent in full
 		FormatHeader(SendBuf);
-		SendData(pEntry);
+		GatherSendBuf(pEntry);
 
-		// send text message
-		if(GetMsgLines())
+		// send text message, a body which is already in the form it is sent in
+		// is sent as it is, otherwise the message lines are sent
+		if(m_sMsgBody.size())
+		{
+			GatherRef(pEntry, m_sMsgBody.c_str(), m_sMsgBody.size());
+		}
+		else if(GetMsgLines())
 		{
 			for(i=0;i<GetMsgLines();i++)
 			{
-				snprintf(SendBuf, BUFFER_SIZE, "%s\r\n",GetMsgLineText(i));
-				SendData(pEntry);
+				GatherRef(pEntry, MsgBody[i].c_str(), MsgBody[i].size());
+				GatherRef(pEntry, "\r\n", 2);
 			}
 		}
 		else
 		{
-			snprintf(SendBuf, BUFFER_SIZE, "%s\r\n"," ");
-			SendData(pEntry);
+			GatherRef(pEntry, " \r\n", 3);
 		}
 
 		// next goes attachments (if they are)
@@ -680,62 +994,342 @@ void CSmtp::Send()
 			strcat(SendBuf, "\"\r\n");
 			strcat(SendBuf, "\r\n");
 
-			SendData(pEntry);
+			GatherSendBuf(pEntry);
 
-			// opening the file:
-			hFile = fopen(Attachments[FileId].c_str(), "rb");
-			if(hFile == NULL)
-				throw ECSmtp(ECSmtp::FILE_NOT_EXIST);
-			
-			// get file size:
-			fseek(hFile, 0, SEEK_END);
-			FileSize = ftell(hFile);
-			fseek (hFile,0,SEEK_SET);
+			FileSize = AttachmentFiles[FileId].Size;
 
-			MsgPart = 0;
-			for(i=0;i<FileSize/54+1;i++)
+			// a file sent before is streamed from the cache, otherwise a file small enough 
+			// to be cached is encoded in full and added to the cache, whole blocks encode
+			// to whole lines so the blocks are encoded one after another
+			if(m_pAttachmentCache)
+			{
+				CacheKey = Attachments[FileId] + "|" + std::to_string(FileSize) + "|" + 
+					std::to_string(AttachmentFiles[FileId].Modified);
+				Encoded = m_pAttachmentCache->Find(CacheKey);
+			}
+			if(!Encoded && m_pAttachmentCache && 
+				m_pAttachmentCache->CanCache(base64_encoded_size(FileSize, BASE64_MIME_LINE_LENGTH)))
 			{
-				res = fread(FileBuf,sizeof(char),54,hFile);
-				MsgPart ? strcat(SendBuf,base64_encode(reinterpret_cast<const unsigned char*>(FileBuf),res).c_str())
-							: strcpy(SendBuf,base64_encode(reinterpret_cast<const unsigned char*>(FileBuf),res).c_str());
-				strcat(SendBuf,"\r\n");
-				MsgPart += res + 2;
-				if(MsgPart >= BUFFER_SIZE/2)
-				{ // sending part of the message
-					MsgPart = 0;
-					SendData(pEntry); // FileBuf, FileName, fclose(hFile);
+				std::shared_ptr<std::string> Encoding = std::make_shared<std::string>(
+					base64_encoded_size(FileSize, BASE64_MIME_LINE_LENGTH), '\0');
+				size_t EncodedSize = 0;
+				for(MsgPart=0;MsgPart<FileSize;MsgPart+=res)
+				{
+					res = FileSize - MsgPart < ATTACHMENT_BLOCK ? FileSize - MsgPart : ATTACHMENT_BLOCK;
+					EncodedSize += EncodeAttachment(AttachmentFiles[FileId], MsgPart, res, 
+						&(*Encoding)[EncodedSize], ReadBuf);
 				}
+				Encoded = Encoding;
+				m_pAttachmentCache->Add(CacheKey, Encoded);
 			}
-			if(MsgPart)
+			if(Encoded)
 			{
-				SendData(pEntry); // FileBuf, FileName, fclose(hFile);
+				GatherRef(pEntry, Encoded->data(), Encoded->size());
+				GatherFlush(pEntry);
+				Encoded.reset();
+			}
+			else
+			{
+				// the file is encoded in blocks of whole 57 byte lines straight into
+				// EncodeBuf, which is written to the socket before it is reused, so only the
+				// block being encoded is read in whatever the size of the file
+				for(MsgPart=0;MsgPart<FileSize;MsgPart+=res)
+				{
+					res = FileSize - MsgPart < ATTACHMENT_BLOCK ? FileSize - MsgPart : ATTACHMENT_BLOCK;
+					GatherRef(pEntry, EncodeBuf, 
+						EncodeAttachment(AttachmentFiles[FileId], MsgPart, res, EncodeBuf, ReadBuf));
+					GatherFlush(pEntry);
+				}
 			}
-			fclose(hFile);
-			hFile=NULL;
+			CloseAttachment(AttachmentFiles[FileId]);
 		}
-		delete[] FileBuf;
-		FileBuf=NULL;
+		delete[] EncodeBuf;
+		EncodeBuf=NULL;
+		delete[] ReadBuf;
+		ReadBuf=NULL;
 		
 		// sending last message block (if there is one or more attachments)
 		if(Attachments.size())
 		{
-			snprintf(SendBuf, BUFFER_SIZE, "\r\n--%s--\r\n",BOUNDARY_TEXT);
+			snprintf(SendBuf, BUFFER_SIZE, "\r\n--%s--\r\n",BOUNDARY_TEXT);
+			GatherSendBuf(pEntry);
+		}
+		
+		// <CRLF> . <CRLF>
+		GatherRef(pEntry, "\r\n.\r\n", 5);
+		GatherFlush(pEntry);
+
+		pEntry = FindCommandEntry(command_DATAEND);
+		ReceiveResponse(pEntry);
+	}
+	catch(const ECSmtp&)
+	{
+		GatherClear();
+		if(EncodeBuf) delete[] EncodeBuf;
+		if(ReadBuf) delete[] ReadBuf;
+		for(FileId=0;FileId<AttachmentFiles.size();FileId++)
+			CloseAttachment(AttachmentFiles[FileId]);
+		// QUIT sent part way through DATA would be read as part of the message
+		if(bInData)
+			CloseSocket();
+		else
+			DisconnectRemoteServer();
+		throw;
+	}
+}
+
+#ifndef LINUX
+////////////////////////////////////////////////////////////////////////////////
+//        NAME: EncodeMappedBlock
+// DESCRIPTION: Encodes part of a mapped file, reading a page of a file which
+//              has been truncated, or is on a share which has gone away,
+//              raises EXCEPTION_IN_PAGE_ERROR which is caught here. Kept
+//              apart from EncodeAttachment as __try can not be used in a
+//              function which needs object unwinding.
+//   ARGUMENTS: const unsigned char *data - mapped data to encode
+//              size_t size - number of bytes to encode
+//              char *out - buffer the encoded text is written to
+//              size_t *written - number of encoded bytes written
+// USES GLOBAL: none
+// MODIFIES GL: none
+//     RETURNS: false if the mapped file could not be read
+////////////////////////////////////////////////////////////////////////////////
+static bool EncodeMappedBlock(const unsigned char *data, size_t size, char *out, size_t *written)
+{
+	__try
+	{
+		*written = base64_encode_to(data, size, out, BASE64_MIME_LINE_LENGTH);
+	}
+	__except(GetExceptionCode() == EXCEPTION_IN_PAGE_ERROR ? EXCEPTION_EXECUTE_HANDLER : EXCEPTION_CONTINUE_SEARCH)
+	{
+		return false;
+	}
+	return true;
+}
+#endif
+
+////////////////////////////////////////////////////////////////////////////////
+//        NAME: OpenAttachment
+// DESCRIPTION: Opens an attachment and reads its size and when it was last
+//              written, on windows the whole file is mapped read only.
+//   ARGUMENTS: const std::string &path - attachment file name
+//              AttachmentFile &file - receives the open file
+// USES GLOBAL: none
+// MODIFIES GL: none
+//     RETURNS: false if the file could not be opened
+////////////////////////////////////////////////////////////////////////////////
+bool CSmtp::OpenAttachment(const std::string& path, AttachmentFile& file)
+{
+	CloseAttachment(file);
+
+#ifndef LINUX
+	HANDLE hFile = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, 
+		FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+	if(hFile == INVALID_HANDLE_VALUE)
+		return false;
+
+	LARGE_INTEGER length;
+	FILETIME lastWrite;
+	if(!GetFileSizeEx(hFile, &length) || static_cast<unsigned long long>(length.QuadPart) > SIZE_MAX ||
+		!GetFileTime(hFile, NULL, NULL, &lastWrite))
+	{
+		CloseHandle(hFile);
+		return false;
+	}
+
+	// an empty file can not be mapped, it is open with nothing to read
+	if(length.QuadPart)
+	{
+		HANDLE hMapping = CreateFileMappingA(hFile, NULL, PAGE_READONLY, 0, 0, NULL);
+		if(hMapping != NULL)
+		{
+			// the view keeps the mapping open
+			file.pView = static_cast<const unsigned char*>(MapViewOfFile(hMapping, FILE_MAP_READ, 0, 0, 0));
+			CloseHandle(hMapping);
+		}
+		if(file.pView == NULL)
+		{
+			CloseHandle(hFile);
+			return false;
+		}
+	}
+	CloseHandle(hFile);
+
+	file.Size = static_cast<size_t>(length.QuadPart);
+	file.Modified = (static_cast<long long>(lastWrite.dwHighDateTime) << 32) | lastWrite.dwLowDateTime;
+#else
+	int hFile = open(path.c_str(), O_RDONLY);
+	if(hFile == -1)
+		return false;
+
+	struct stat status;
+	if(fstat(hFile, &status) != 0 || !S_ISREG(status.st_mode))
+	{
+		close(hFile);
+		return false;
+	}
+
+	posix_fadvise(hFile, 0, 0, POSIX_FADV_SEQUENTIAL);
+	file.hFile = hFile;
+	file.Size = static_cast<size_t>(status.st_size);
+	file.Modified = static_cast<long long>(status.st_mtim.tv_sec) * 1000000000 + status.st_mtim.tv_nsec;
+#endif
+	return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//        NAME: CloseAttachment
+// DESCRIPTION: Closes an attachment opened by OpenAttachment, does nothing
+//              if the file is not open.
+//   ARGUMENTS: AttachmentFile &file - file to close
+// USES GLOBAL: none
+// MODIFIES GL: none
+//     RETURNS: void
+////////////////////////////////////////////////////////////////////////////////
+void CSmtp::CloseAttachment(AttachmentFile& file)
+{
+#ifndef LINUX
+	if(file.pView != NULL)
+		UnmapViewOfFile(file.pView);
+	file.pView = NULL;
+#else
+	if(file.hFile != -1)
+		close(file.hFile);
+	file.hFile = -1;
+#endif
+	file.Size = 0;
+	file.Modified = 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//        NAME: EncodeAttachment
+// DESCRIPTION: Base64 encodes part of an open attachment in to out. A file
+//              which is shorter than when it was opened, or can no longer be
+//              read, is an error rather than a crash on the missing data.
+//   ARGUMENTS: AttachmentFile &file - open attachment
+//              size_t offset - offset of the first byte to encode
+//              size_t size - number of bytes to encode
+//              char *out - buffer the encoded text is written to
+//              unsigned char *readBuf - LINUX only, at least size bytes
+// USES GLOBAL: none
+// MODIFIES GL: none
+//     RETURNS: number of encoded bytes written to out
+////////////////////////////////////////////////////////////////////////////////
+size_t CSmtp::EncodeAttachment(AttachmentFile& file, size_t offset, size_t size, char* out, unsigned char* readBuf)
+{
+	size_t written = 0;
+
+#ifndef LINUX
+	if(!EncodeMappedBlock(file.pView + offset, size, out, &written))
+		throw ECSmtp(ECSmtp::FILE_READ_ERROR);
+#else
+	size_t done = 0;
+	while(done < size)
+	{
+		ssize_t res = pread(file.hFile, readBuf + done, size - done, offset + done);
+		if(res < 0 && errno == EINTR)
+			continue;
+		// nothing left to read means the file has been truncated
+		if(res <= 0)
+			throw ECSmtp(ECSmtp::FILE_READ_ERROR);
+		done += res;
+	}
+	written = base64_encode_to(readBuf, size, out, BASE64_MIME_LINE_LENGTH);
+#endif
+	return written;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//        NAME: SendEnvelopePipelined
+// DESCRIPTION: Sends MAIL FROM, every RCPT TO and DATA without waiting for
+//              the individual replies, the replies are then read back in
+//              order (RFC 2920). Recipients refused by the server are added
+//              to RejectedRecipients, the message is still sent as long as
+//              at least one recipient has been accepted.
+//   ARGUMENTS: none
+// USES GLOBAL: m_sMailFrom, Recipients, CCRecipients, BCCRecipients, SendBuf
+// MODIFIES GL: SendBuf, RecvBuf, RejectedRecipients
+//     RETURNS: void
+////////////////////////////////////////////////////////////////////////////////
+void CSmtp::SendEnvelopePipelined()
+{
+	std::vector<const Recipient*> envelope;
+	std::string batch;
+	size_t i;
+
+	for(i=0;i<Recipients.size();i++)
+		envelope.push_back(&Recipients.at(i));
+	for(i=0;i<CCRecipients.size();i++)
+		envelope.push_back(&CCRecipients.at(i));
+	for(i=0;i<BCCRecipients.size();i++)
+		envelope.push_back(&BCCRecipients.at(i));
+
+	batch = "MAIL FROM:<" + m_sMailFrom + ">\r\n";
+	for(i=0;i<envelope.size();i++)
+		batch += "RCPT TO:<" + envelope[i]->Mail + ">\r\n";
+	batch += "DATA\r\n";
+
+	// the batch is written in blocks which fit the send buffer
+	Command_Entry* pEntry = FindCommandEntry(command_RCPTTO);
+	std::chrono::steady_clock::time_point started = std::chrono::steady_clock::now();
+	for(size_t sent = 0; sent < batch.size(); )
+	{
+		size_t block = batch.size() - sent;
+		if(block > BUFFER_SIZE - 1)
+			block = BUFFER_SIZE - 1;
+		memcpy(SendBuf, batch.c_str() + sent, block);
+		SendBuf[block] = '\0';
+		SendData(pEntry);
+		sent += block;
+	}
+
+	pEntry = FindCommandEntry(command_MAILFROM);
+	int sender_reply = ReadReply(pEntry);
+	m_iReplyLatency = static_cast<unsigned long>(std::chrono::duration_cast<std::chrono::microseconds>(
+		std::chrono::steady_clock::now() - started).count());
+	bool bSenderAccepted = sender_reply == pEntry->valid_reply_code;
+
+	unsigned int accepted = 0;
+	int rcpt_reply = 0;
+	pEntry = FindCommandEntry(command_RCPTTO);
+	for(i=0;i<envelope.size();i++)
+	{
+		rcpt_reply = ReadReply(pEntry);
+		if(rcpt_reply == pEntry->valid_reply_code)
+			accepted++;
+		else
+			RejectedRecipients.push_back(envelope[i]->Mail);
+	}
+
+	pEntry = FindCommandEntry(command_DATA);
+	int data_reply = ReadReply(pEntry);
+
+	// the server may still accept the pipelined DATA when the sender or every
+	// recipient was refused (RFC 2920 3.1), an empty message is ended so the
+	// session is not left reading message text, if that fails it is closed
+	if(data_reply == pEntry->valid_reply_code && (!bSenderAccepted || accepted == 0))
+	{
+		try
+		{
+			pEntry = FindCommandEntry(command_DATAEND);
+			snprintf(SendBuf, BUFFER_SIZE, ".\r\n");
 			SendData(pEntry);
+			ReadReply(pEntry);
+		}
+		catch(const ECSmtp&)
+		{
+			CloseSocket();
 		}
-		
-		pEntry = FindCommandEntry(command_DATAEND);
-		// <CRLF> . <CRLF>
-		snprintf(SendBuf, BUFFER_SIZE, "\r\n.\r\n");
-		SendData(pEntry);
-		ReceiveResponse(pEntry);
-	}
-	catch(const ECSmtp&)
-	{
-		if(hFile) fclose(hFile);
-		if(FileBuf) delete[] FileBuf;
-		DisconnectRemoteServer();
-		throw;
 	}
+
+	if(!bSenderAccepted)
+		throw ECSmtp(ECSmtp::COMMAND_MAIL_FROM, sender_reply);
+
+	if(accepted == 0)
+		throw ECSmtp(ECSmtp::COMMAND_RCPT_TO, rcpt_reply);
+
+	if(data_reply != pEntry->valid_reply_code)
+		throw ECSmtp(pEntry->error, data_reply);
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -770,6 +1364,7 @@ bool CSmtp::ConnectRemoteServer(const char* szServer, const unsigned short nPort
 		timeout.tv_usec = 0;
 
 		hSocket = INVALID_SOCKET;
+		m_sRecvPending.clear();
 
 		if((hSocket = socket(PF_INET, SOCK_STREAM,0)) == INVALID_SOCKET)
 			throw ECSmtp(ECSmtp::WSA_INVALID_SOCKET);
@@ -1238,8 +1833,38 @@ bool CSmtp::ConnectRemoteServer(const char* szServer, const unsigned short nPort
 ////////////////////////////////////////////////////////////////////////////////
 void CSmtp::DisconnectRemoteServer()
 {
-	if(m_bConnected) SayQuit();
-	if(hSocket)
+	// a failed QUIT must not leave the socket open, pooled sessions are
+	// disconnected after errors when the server may already have gone
+	try
+	{
+		if(m_bConnected) SayQuit();
+	}
+	catch(const ECSmtp&)
+	{
+	}
+
+	CloseSocket();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//        NAME: CloseSocket
+// DESCRIPTION: Closes the connection without sending QUIT, used when the
+//              session is known to be unusable so QUIT would only wait for
+//              the command to time out.
+//   ARGUMENTS: none
+// USES GLOBAL: hSocket, m_sRecvPending, m_bPipelining
+// MODIFIES GL: hSocket, m_sRecvPending, m_bPipelining, m_bConnected
+//     RETURNS: void
+////////////////////////////////////////////////////////////////////////////////
+void CSmtp::CloseSocket()
+{
+	m_bConnected = false;
+	CleanupOpenSSL();
+	m_sRecvPending.clear();
+	m_bPipelining = false;
+	GatherClear();
+
+	if(hSocket != INVALID_SOCKET)
 	{
 #ifdef LINUX
 		close(hSocket);
@@ -1308,6 +1933,8 @@ void CSmtp::FormatHeader(char* header)
 			to.append(">");
 		}
 	}
+	else if(BCCRecipients.size())
+		to = "undisclosed-recipients:;";
 	else
 		throw ECSmtp(ECSmtp::UNDEF_RECIPIENTS);
 
@@ -1496,7 +2123,7 @@ void CSmtp::ReceiveData(Command_Entry* pEntry)
 
 	if(FD_ISSET(hSocket,&fdread))
 	{
-		res = recv(hSocket,RecvBuf,BUFFER_SIZE,0);
+		res = recv(hSocket,RecvBuf,BUFFER_SIZE-1,0);
 		if(res == SOCKET_ERROR)
 		{
 			FD_CLR(hSocket,&fdread);
@@ -1577,6 +2204,249 @@ void CSmtp::SendData(Command_Entry* pEntry)
 	FD_CLR(hSocket,&fdwrite);
 }
 
+////////////////////////////////////////////////////////////////////////////////
+//        NAME: GatherRef
+// DESCRIPTION: Adds text to the data being gathered without copying it, the
+//              text must not change until the gathered data has been sent.
+//   ARGUMENTS: Command_Entry* pEntry - command the data belongs to
+//              const char* data - text to send
+//              size_t size - length of the text
+// USES GLOBAL: m_vGather, m_iGatherBytes
+// MODIFIES GL: m_vGather, m_iGatherBytes
+//     RETURNS: void
+////////////////////////////////////////////////////////////////////////////////
+void CSmtp::GatherRef(Command_Entry* pEntry, const char* data, size_t size)
+{
+	GatherSegment segment = { data, 0, size };
+	m_vGather.push_back(segment);
+	m_iGatherBytes += size;
+
+	if(m_iGatherBytes >= GATHER_SIZE || m_vGather.size() >= GATHER_SEGMENTS)
+		GatherFlush(pEntry);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//        NAME: GatherCopy
+// DESCRIPTION: Adds a copy of the text to the data being gathered, the gather
+//              buffer grows as required.
+//   ARGUMENTS: Command_Entry* pEntry - command the data belongs to
+//              const char* data - text to send
+//              size_t size - length of the text
+// USES GLOBAL: m_vGather, m_sGatherBuffer, m_iGatherBytes
+// MODIFIES GL: m_vGather, m_sGatherBuffer, m_iGatherBytes
+//     RETURNS: void
+////////////////////////////////////////////////////////////////////////////////
+void CSmtp::GatherCopy(Command_Entry* pEntry, const char* data, size_t size)
+{
+	// text copied straight after the previous copy extends the same segment
+	if(m_vGather.size() && m_vGather.back().data == NULL &&
+		m_vGather.back().offset + m_vGather.back().size == m_sGatherBuffer.size())
+	{
+		m_vGather.back().size += size;
+	}
+	else
+	{
+		GatherSegment segment = { NULL, m_sGatherBuffer.size(), size };
+		m_vGather.push_back(segment);
+	}
+
+	m_sGatherBuffer.append(data, size);
+	m_iGatherBytes += size;
+
+	if(m_iGatherBytes >= GATHER_SIZE || m_vGather.size() >= GATHER_SEGMENTS)
+		GatherFlush(pEntry);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//        NAME: GatherSendBuf
+// DESCRIPTION: Adds a copy of the text in SendBuf to the data being gathered.
+//   ARGUMENTS: Command_Entry* pEntry - command the data belongs to
+// USES GLOBAL: SendBuf
+// MODIFIES GL: m_vGather, m_sGatherBuffer, m_iGatherBytes
+//     RETURNS: void
+////////////////////////////////////////////////////////////////////////////////
+void CSmtp::GatherSendBuf(Command_Entry* pEntry)
+{
+	assert(SendBuf);
+
+	if(SendBuf == NULL)
+		throw ECSmtp(ECSmtp::SENDBUF_IS_EMPTY);
+
+	GatherCopy(pEntry, SendBuf, strlen(SendBuf));
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//        NAME: GatherFlush
+// DESCRIPTION: Sends all of the gathered data.  Without SSL the segments are
+//              passed to a single gathered write (WSASend/writev), so the
+//              number of calls depends on the size of the data not on the
+//              number of lines.  With SSL the segments are copied in to
+//              blocks the size of an SSL record.
+//   ARGUMENTS: Command_Entry* pEntry - command the data belongs to
+// USES GLOBAL: hSocket, m_ssl, m_vGather, m_sGatherBuffer
+// MODIFIES GL: m_vGather, m_sGatherBuffer, m_iGatherBytes
+//     RETURNS: void
+////////////////////////////////////////////////////////////////////////////////
+void CSmtp::GatherFlush(Command_Entry* pEntry)
+{
+	size_t i;
+
+	if(!m_vGather.size())
+		return;
+
+	if(m_ssl != NULL)
+	{
+		std::string block;
+		block.reserve(SSL_RECORD_SIZE);
+
+		for(i=0;i<m_vGather.size();i++)
+		{
+			const char* data = m_vGather[i].data ? m_vGather[i].data : m_sGatherBuffer.c_str() + m_vGather[i].offset;
+			size_t size = m_vGather[i].size;
+
+			while(size > 0)
+			{
+				size_t part = SSL_RECORD_SIZE - block.size();
+				if(part > size)
+					part = size;
+
+				block.append(data, part);
+				data += part;
+				size -= part;
+
+				if(block.size() == SSL_RECORD_SIZE)
+				{
+					SendBytes_SSL(m_ssl, pEntry, block.c_str(), (int)block.size());
+					block.clear();
+				}
+			}
+		}
+
+		if(block.size())
+			SendBytes_SSL(m_ssl, pEntry, block.c_str(), (int)block.size());
+
+		GatherClear();
+		return;
+	}
+
+#ifdef LINUX
+	std::vector<struct iovec> buffers(m_vGather.size());
+#else
+	std::vector<WSABUF> buffers(m_vGather.size());
+#endif
+
+	for(i=0;i<m_vGather.size();i++)
+	{
+		const char* data = m_vGather[i].data ? m_vGather[i].data : m_sGatherBuffer.c_str() + m_vGather[i].offset;
+#ifdef LINUX
+		buffers[i].iov_base = (void*)data;
+		buffers[i].iov_len = m_vGather[i].size;
+#else
+		buffers[i].buf = (CHAR*)data;
+		buffers[i].len = (ULONG)m_vGather[i].size;
+#endif
+	}
+
+	size_t first = 0;
+	int res;
+	fd_set fdwrite;
+	timeval time;
+
+	while(first < buffers.size())
+	{
+		time.tv_sec = pEntry->send_timeout;
+		time.tv_usec = 0;
+
+		FD_ZERO(&fdwrite);
+		FD_SET(hSocket,&fdwrite);
+
+		if((res = select(hSocket+1,NULL,&fdwrite,NULL,&time)) == SOCKET_ERROR)
+		{
+			FD_CLR(hSocket,&fdwrite);
+			throw ECSmtp(ECSmtp::WSA_SELECT);
+		}
+
+		if(!res)
+		{
+			//timeout
+			FD_CLR(hSocket,&fdwrite);
+			throw ECSmtp(ECSmtp::SERVER_NOT_RESPONDING);
+		}
+
+		size_t sent;
+#ifdef LINUX
+		ssize_t written = writev(hSocket, &buffers[first], (int)(buffers.size() - first));
+		if(written < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+			continue;
+		if(written <= 0)
+		{
+			FD_CLR(hSocket,&fdwrite);
+			throw ECSmtp(ECSmtp::WSA_SEND);
+		}
+		sent = (size_t)written;
+#else
+		DWORD written = 0;
+		if(WSASend(hSocket, &buffers[first], (DWORD)(buffers.size() - first), &written, 0, NULL, NULL) == SOCKET_ERROR)
+		{
+			if(WSAGetLastError() == WSAEWOULDBLOCK)
+				continue;
+			FD_CLR(hSocket,&fdwrite);
+			throw ECSmtp(ECSmtp::WSA_SEND);
+		}
+		if(written == 0)
+		{
+			FD_CLR(hSocket,&fdwrite);
+			throw ECSmtp(ECSmtp::WSA_SEND);
+		}
+		sent = (size_t)written;
+#endif
+
+		// skip the segments which were sent, a segment only partly sent is
+		// moved on past the part which was
+		while(first < buffers.size())
+		{
+#ifdef LINUX
+			size_t size = buffers[first].iov_len;
+#else
+			size_t size = buffers[first].len;
+#endif
+			if(sent < size)
+			{
+#ifdef LINUX
+				buffers[first].iov_base = (char*)buffers[first].iov_base + sent;
+				buffers[first].iov_len -= sent;
+#else
+				buffers[first].buf += sent;
+				buffers[first].len -= (ULONG)sent;
+#endif
+				break;
+			}
+
+			sent -= size;
+			first++;
+		}
+	}
+
+	FD_CLR(hSocket,&fdwrite);
+	GatherClear();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//        NAME: GatherClear
+// DESCRIPTION: Discards any gathered data which has not been sent.
+//   ARGUMENTS: none
+// USES GLOBAL: m_vGather, m_sGatherBuffer, m_iGatherBytes
+// MODIFIES GL: m_vGather, m_sGatherBuffer, m_iGatherBytes
+//     RETURNS: void
+////////////////////////////////////////////////////////////////////////////////
+void CSmtp::GatherClear()
+{
+	// the buffer keeps its capacity so later messages do not allocate it again
+	m_vGather.clear();
+	m_sGatherBuffer.clear();
+	m_iGatherBytes = 0;
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 //        NAME: GetLocalHostName
 // DESCRIPTION: Returns local host name. 
@@ -1739,6 +2609,47 @@ unsigned int CSmtp::GetMsgLines() const
 	return MsgBody.size();
 }
 
+////////////////////////////////////////////////////////////////////////////////
+//        NAME: GetRejectedRecipientCount
+// DESCRIPTION: Returns the number of recipients refused by the server during
+//              the last pipelined Send.
+//   ARGUMENTS: none
+// USES GLOBAL: RejectedRecipients
+// MODIFIES GL: none
+//     RETURNS: number of rejected recipients
+////////////////////////////////////////////////////////////////////////////////
+unsigned int CSmtp::GetRejectedRecipientCount() const
+{
+	return RejectedRecipients.size();
+}
+
+const char* CSmtp::GetRejectedRecipient(unsigned int index) const
+{
+	if(index >= RejectedRecipients.size())
+		throw ECSmtp(ECSmtp::OUT_OF_MSG_RANGE);
+	return RejectedRecipients.at(index).c_str();
+}
+
+bool CSmtp::IsPipeliningSupported() const
+{
+	return m_bPipelining;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//        NAME: GetReplyLatency
+// DESCRIPTION: Time the server took to reply to MAIL FROM in the last Send,
+//              unlike the time taken by Send it does not depend on the size
+//              of the message or on connecting to the server.
+//   ARGUMENTS: none
+// USES GLOBAL: m_iReplyLatency
+// MODIFIES GL: none
+//     RETURNS: microseconds, 0 if no reply has been received
+////////////////////////////////////////////////////////////////////////////////
+unsigned long CSmtp::GetReplyLatency() const
+{
+	return m_iReplyLatency;
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 //        NAME: SetCharSet
 // DESCRIPTION: Allows the character set to be changed from default of US-ASCII. 
@@ -1785,6 +2696,21 @@ void CSmtp::SetXPriority(CSmptXPriority priority)
 	m_iXPriority = priority;
 }
 
+////////////////////////////////////////////////////////////////////////////////
+//        NAME: SetAttachmentCache
+// DESCRIPTION: Sets the cache encoded attachments are kept in, the cache is
+//              not owned and must outlive the object.
+//   ARGUMENTS: CSmtpAttachmentCache *cache - cache to use, NULL to encode
+//              every attachment as it is sent
+// USES GLOBAL: none
+// MODIFIES GL: m_pAttachmentCache
+//     RETURNS: none
+////////////////////////////////////////////////////////////////////////////////
+void CSmtp::SetAttachmentCache(CSmtpAttachmentCache* cache)
+{
+	m_pAttachmentCache = cache;
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 //        NAME: SetReplyTo
 // DESCRIPTION: Setting the return address.
@@ -2009,6 +2935,8 @@ std::string ECSmtp::GetErrorText() const
 			return "Server returned error after sending RCPT TO";
 		case ECSmtp::MSG_BODY_ERROR:
 			return "Error in message body";
+		case ECSmtp::COMMAND_RSET:
+			return "Server returned error after sending RSET";
 		case ECSmtp::CONNECTION_CLOSED:
 			return "Server has closed the connection";
 		case ECSmtp::SERVER_NOT_READY:
@@ -2043,6 +2971,8 @@ std::string ECSmtp::GetErrorText() const
 			return "The STARTTLS command is not supported by the server";
 		case ECSmtp::LOGIN_NOT_SUPPORTED:
 			return "AUTH LOGIN is not supported by the server";
+		case ECSmtp::FILE_READ_ERROR:
+			return "Attachment file could not be read, it may have changed whilst being sent";
 		default:
 			return "Undefined error id";
 	}
@@ -2055,6 +2985,7 @@ void CSmtp::SayHello()
 	SendData(pEntry);
 	ReceiveResponse(pEntry);
 	m_bConnected=true;
+	m_bPipelining = IsKeywordSupported(RecvBuf, "PIPELINING");
 }
 
 void CSmtp::SayQuit()
@@ -2080,6 +3011,9 @@ void CSmtp::StartTls()
 	SendData(pEntry);
 	ReceiveResponse(pEntry);
 
+	// anything received before the handshake must not be trusted (RFC 3207)
+	m_sRecvPending.clear();
+
 	OpenSSLConnect();
 }
 
@@ -2203,63 +3137,69 @@ void CSmtp::ReceiveData_SSL(SSL* ssl, Command_Entry* pEntry)
 }
 
 void CSmtp::ReceiveResponse(Command_Entry* pEntry)
+{
+	int reply_code = ReadReply(pEntry);
+	if(reply_code != pEntry->valid_reply_code)
+	{
+		throw ECSmtp(pEntry->error, reply_code);
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//        NAME: ReadReply
+// DESCRIPTION: Reads the next complete reply from the server. Data received
+//              after the end of the reply is kept for the next call, which is
+//              required when several pipelined replies arrive together.
+//   ARGUMENTS: Command_Entry* pEntry - command the reply belongs to
+// USES GLOBAL: RecvBuf, m_sRecvPending
+// MODIFIES GL: RecvBuf, m_sRecvPending
+//     RETURNS: the three digit reply code
+////////////////////////////////////////////////////////////////////////////////
+int CSmtp::ReadReply(Command_Entry* pEntry)
 {
 	std::string line;
+	line.swap(m_sRecvPending);
 	int reply_code = 0;
-	bool bFinish = false;
-	while(!bFinish)
+	size_t end = 0;
+
+	while(!FindReplyEnd(line, end, reply_code))
 	{
 		ReceiveData(pEntry);
 		line.append(RecvBuf);
-		size_t len = line.length();
-		size_t begin = 0;
-		size_t offset = 0;
-
-		while(1) // loop for all lines
-		{
-			while(offset + 1 < len)
-			{
-				if(line[offset] == '\r' && line[offset+1] == '\n')
-					break;
-				++offset;
-			}
-			if(offset + 1 < len) // we found a line
-			{
-				// see if this is the last line
-				// the last line must match the pattern: XYZ<SP>*<CRLF> or XYZ<CRLF> where XYZ is a string of 3 digits 
-				offset += 2; // skip <CRLF>
-				if(offset - begin >= 5)
-				{
-					if(isdigit(line[begin]) && isdigit(line[begin+1]) && isdigit(line[begin+2]))
-					{
-						// this is the last line
-						if(offset - begin == 5 || line[begin+3] == ' ')
-						{
-							reply_code = (line[begin]-'0')*100 + (line[begin+1]-'0')*10 + line[begin+2]-'0';
-							bFinish = true;
-							break;
-						}
-					}
-				}
-				begin = offset;	// try to find next line
-			}
-			else // we haven't received the last line, so we need to receive more data 
-			{
-				break;
-			}
-		}
 	}
-	snprintf(RecvBuf, BUFFER_SIZE, line.c_str());
+
+	m_sRecvPending = line.substr(end);
+	line.erase(end);
+	snprintf(RecvBuf, BUFFER_SIZE, "%s", line.c_str());
 	OutputDebugStringA(RecvBuf);
-	if(reply_code != pEntry->valid_reply_code)
-	{
-		throw ECSmtp(pEntry->error);
-	}
+	return reply_code;
 }
 
 void CSmtp::SendData_SSL(SSL* ssl, Command_Entry* pEntry)
 {
-	int offset = 0,res,nLeft = strlen(SendBuf);
+	assert(SendBuf);
+
+	if(SendBuf == NULL)
+		throw ECSmtp(ECSmtp::SENDBUF_IS_EMPTY);
+
+	SendBytes_SSL(ssl, pEntry, SendBuf, strlen(SendBuf));
+	OutputDebugStringA(SendBuf);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//        NAME: SendBytes_SSL
+// DESCRIPTION: Writes a block of data over the SSL connection.
+//   ARGUMENTS: SSL* ssl - connection to write to
+//              Command_Entry* pEntry - command the data belongs to
+//              const char* data - data to write, need not be null terminated
+//              int size - number of bytes to write
+// USES GLOBAL: hSocket
+// MODIFIES GL: none
+//     RETURNS: void
+////////////////////////////////////////////////////////////////////////////////
+void CSmtp::SendBytes_SSL(SSL* ssl, Command_Entry* pEntry, const char* data, int size)
+{
+	int offset = 0,res,nLeft = size;
 	fd_set fdwrite;
 	fd_set fdread;
 	timeval time;
@@ -2269,11 +3209,6 @@ void CSmtp::SendData_SSL(SSL* ssl, Command_Entry* pEntry)
 	time.tv_sec = pEntry->send_timeout;
 	time.tv_usec = 0;
 
-	assert(SendBuf);
-
-	if(SendBuf == NULL)
-		throw ECSmtp(ECSmtp::SENDBUF_IS_EMPTY);
-
 	while(nLeft > 0)
 	{
 		FD_ZERO(&fdwrite);
@@ -2306,7 +3241,7 @@ void CSmtp::SendData_SSL(SSL* ssl, Command_Entry* pEntry)
 			write_blocked_on_read=0;
 
 			/* Try to write */
-			res = SSL_write(ssl, SendBuf+offset, nLeft);
+			res = SSL_write(ssl, data+offset, nLeft);
 	          
 			switch(SSL_get_error(ssl,res))
 			{
@@ -2340,16 +3275,24 @@ void CSmtp::SendData_SSL(SSL* ssl, Command_Entry* pEntry)
 		}
 	}
 
-	OutputDebugStringA(SendBuf);
 	FD_ZERO(&fdwrite);
 	FD_ZERO(&fdread);
 }
 
+unsigned long long CSmtp::GetFullHandshakeCount()
+{
+	return (fullHandshakes);
+}
+
+unsigned long long CSmtp::GetResumedHandshakeCount()
+{
+	return (resumedHandshakes);
+}
+
 void CSmtp::InitOpenSSL()
 {
-	SSL_library_init();
-	SSL_load_error_strings();
-	m_ctx = SSL_CTX_new (SSLv23_client_method());
+	// the context is shared, only the SSL object is created per connection
+	m_ctx = GetSharedSSLContext(GetSecurityType());
 	if(m_ctx == NULL)
 		throw ECSmtp(ECSmtp::SSL_PROBLEM);
 }
@@ -2364,6 +3307,19 @@ void CSmtp::OpenSSLConnect()
 	SSL_set_fd (m_ssl, (int)hSocket);
     SSL_set_mode(m_ssl, SSL_MODE_AUTO_RETRY);
 
+	// offer the last session negotiated with this server
+	char port[8];
+	snprintf(port, sizeof(port), "%u", m_iSMTPSrvPort);
+	m_sTlsSessionKey = m_sSMTPSrvName + ":" + port + ":" + (m_type == USE_SSL ? "ssl" : "tls");
+	SSL_set_app_data(m_ssl, &m_sTlsSessionKey);
+
+	SSL_SESSION *session = FindTlsSession(m_sTlsSessionKey);
+	if(session != NULL)
+	{
+		SSL_set_session(m_ssl, session);
+		SSL_SESSION_free(session);
+	}
+
 	int res = 0;
 	fd_set fdwrite;
 	fd_set fdread;
@@ -2408,6 +3364,10 @@ void CSmtp::OpenSSLConnect()
 		  case SSL_ERROR_NONE:
 			FD_ZERO(&fdwrite);
 			FD_ZERO(&fdread);
+			if(SSL_session_reused(m_ssl))
+				resumedHandshakes++;
+			else
+				fullHandshakes++;
 			return;
 			break;
               
@@ -2422,6 +3382,8 @@ void CSmtp::OpenSSLConnect()
 		  default:	      
 			FD_ZERO(&fdwrite);
 			FD_ZERO(&fdread);
+			// a stale session must not be offered again
+			RemoveTlsSession(m_sTlsSessionKey);
 			throw ECSmtp(ECSmtp::SSL_PROBLEM);
 		}
 	}
@@ -2435,13 +3397,8 @@ void CSmtp::CleanupOpenSSL()
 		SSL_free (m_ssl);
 		m_ssl = NULL;
 	}
-	if(m_ctx != NULL)
-	{
-		SSL_CTX_free (m_ctx);	
-		m_ctx = NULL;
-		ERR_remove_state(0);
-		ERR_free_strings();
-		EVP_cleanup();
-		CRYPTO_cleanup_all_ex_data();
-	}
+
+	// the context is owned by the process wide cache and is never freed here,
+	// other connections may still be using it
+	m_ctx = NULL;
 }
\ No newline at end of file
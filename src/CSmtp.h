@@ -8,12 +8,15 @@
 
 
 #include <vector>
+#include <string>
+#include <memory>
 #include <string.h>
 #include <assert.h>
 
 #ifdef __linux__
 	#include <sys/types.h>
 	#include <sys/socket.h>
+	#include <sys/uio.h>
 	#include <sys/ioctl.h>
 	#include <netinet/in.h>
 	#include <arpa/inet.h>
@@ -65,6 +68,10 @@
 #define BUFFER_SIZE		10240	// SendData and RecvData buffers sizes
 #define MSG_SIZE_IN_MB	25		// the maximum size of the message with all attachments
 #define COUNTER_VALUE	100		// how many times program will try to receive data
+#define GATHER_SIZE		65536	// DATA is sent once this many bytes have been gathered
+#define GATHER_SEGMENTS	1024	// or once this many segments have been gathered
+#define SSL_RECORD_SIZE	16384	// gathered segments are written to SSL in blocks of this size
+#define ATTACHMENT_BLOCK	58368	// attachments are encoded in blocks of this size, 1024 base64 lines
 
 const char BOUNDARY_TEXT[] = "__MESSAGE__ID__54yg6f6h6y456345";
 
@@ -113,6 +120,7 @@ public:
 		COMMAND_QUIT,
 		COMMAND_RCPT_TO,
 		MSG_BODY_ERROR,
+		COMMAND_RSET,
 		CONNECTION_CLOSED = 400, // by server
 		SERVER_NOT_READY, // remote server
 		SERVER_NOT_RESPONDING,
@@ -130,14 +138,17 @@ public:
 		SSL_PROBLEM,
 		COMMAND_DATABLOCK,
 		STARTTLS_NOT_SUPPORTED,
-		LOGIN_NOT_SUPPORTED
+		LOGIN_NOT_SUPPORTED,
+		FILE_READ_ERROR
 	};
-	ECSmtp(CSmtpError err_) : ErrorCode(err_) {}
+	ECSmtp(CSmtpError err_, int replyCode_ = 0) : ErrorCode(err_), ReplyCode(replyCode_) {}
 	CSmtpError GetErrorNum(void) const {return ErrorCode;}
+	int GetReplyCode(void) const {return ReplyCode;} // zero if the error was not a server reply
 	std::string GetErrorText(void) const;
 
 private:
 	CSmtpError ErrorCode;
+	int ReplyCode;
 };
 
 enum SMTP_COMMAND
@@ -157,7 +168,8 @@ enum SMTP_COMMAND
 	command_DATABLOCK,
 	command_DATAEND,
 	command_QUIT,
-	command_STARTTLS
+	command_STARTTLS,
+	command_RSET
 };
 
 // TLS/SSL extension
@@ -178,6 +190,17 @@ typedef struct tagCommand_Entry
 	ECSmtp::CSmtpError error;
 }Command_Entry;
 
+// encoded attachments are looked up in a cache supplied by the caller before they
+// are encoded, the key is made from the file name, size and modification time
+class CSmtpAttachmentCache
+{
+public:
+	virtual ~CSmtpAttachmentCache() {}
+	virtual std::shared_ptr<const std::string> Find(const std::string& key) = 0;
+	virtual bool CanCache(size_t encodedSize) = 0;
+	virtual void Add(const std::string& key, const std::shared_ptr<const std::string>& encoded) = 0;
+};
+
 class CSmtp  
 {
 public:
@@ -189,6 +212,7 @@ public:
 	void AddCCRecipient(const char *email, const char *name=NULL);    
 	void AddAttachment(const char *path);   
 	void AddMsgLine(const char* text);
+	void SetMsgBody(std::string &&body);
 	void ClearMessage();
 	bool ConnectRemoteServer(const char* szServer, const unsigned short nPort_=0,
 							 SMTP_SECURITY_TYPE securityType=DO_NOT_SET,
@@ -202,9 +226,15 @@ public:
 	void DelMsgLines(void);
 	void DelMsgLine(unsigned int line);
 	void ModMsgLine(unsigned int line,const char* text);
+	void Reset();
+	bool IsConnected() const;
 	unsigned int GetBCCRecipientCount() const;    
 	unsigned int GetCCRecipientCount() const;
 	unsigned int GetRecipientCount() const;    
+	unsigned int GetRejectedRecipientCount() const;
+	const char* GetRejectedRecipient(unsigned int index) const;
+	bool IsPipeliningSupported() const;
+	unsigned long GetReplyLatency() const;
 	const char* GetLocalHostIP() const;
 	const char* GetLocalHostName();
 	const char* GetMsgLineText(unsigned int line) const;
@@ -227,6 +257,7 @@ public:
 	void SetLogin(const char*);
 	void SetPassword(const char*);
 	void SetXPriority(CSmptXPriority);
+	void SetAttachmentCache(CSmtpAttachmentCache* cache);
 	void SetSMTPServer(const char* server, const unsigned short port=0, bool authenticate=true);
 
 private:	
@@ -250,6 +281,9 @@ private:
 	
 	SOCKET hSocket;
 	bool m_bConnected;
+	bool m_bPipelining;
+	unsigned long m_iReplyLatency;
+	std::string m_sRecvPending;
 
 	struct Recipient
 	{
@@ -262,6 +296,39 @@ private:
 	std::vector<Recipient> BCCRecipients;
 	std::vector<std::string> Attachments;
 	std::vector<std::string> MsgBody;
+	std::string m_sMsgBody;
+	std::vector<std::string> RejectedRecipients;
+	CSmtpAttachmentCache* m_pAttachmentCache;
+
+	// the DATA payload is gathered as a list of segments and sent in large writes, a
+	// segment either points to text held elsewhere for the whole send, such as the
+	// message lines, or to text copied in to the gather buffer
+	struct GatherSegment
+	{
+		const char* data;	// NULL if the segment is held in m_sGatherBuffer
+		size_t offset;		// offset in to m_sGatherBuffer
+		size_t size;
+	};
+
+	std::vector<GatherSegment> m_vGather;
+	std::string m_sGatherBuffer;
+	size_t m_iGatherBytes;
+
+	// an attachment is opened when the size of the message is checked and stays
+	// open until it has been sent, on windows the file is mapped, elsewhere it is
+	// read a block at a time so a file truncated whilst it is sent is a read error
+	struct AttachmentFile
+	{
+		size_t Size;
+		long long Modified;
+#ifdef LINUX
+		int hFile;
+		AttachmentFile() : Size(0), Modified(0), hFile(-1) {}
+#else
+		const unsigned char* pView;
+		AttachmentFile() : Size(0), Modified(0), pView(NULL) {}
+#endif
+	};
  
 	void ReceiveData(Command_Entry* pEntry);
 	void SendData(Command_Entry* pEntry);
@@ -269,6 +336,11 @@ private:
 	int SmtpXYZdigits();
 	void SayHello();
 	void SayQuit();
+	void CloseSocket();
+	bool IsSessionStale();
+	bool OpenAttachment(const std::string& path, AttachmentFile& file);
+	void CloseAttachment(AttachmentFile& file);
+	size_t EncodeAttachment(AttachmentFile& file, size_t offset, size_t size, char* out, unsigned char* readBuf);
 
 // TLS/SSL extension
 public:
@@ -278,17 +350,29 @@ public:
 	{ m_type = type; }
 	bool m_bHTML;
 
+	static unsigned long long GetFullHandshakeCount();
+	static unsigned long long GetResumedHandshakeCount();
+
 private:
 	SMTP_SECURITY_TYPE m_type;
 	SSL_CTX*      m_ctx;
 	SSL*          m_ssl;
+	std::string   m_sTlsSessionKey;
 
 	void ReceiveResponse(Command_Entry* pEntry);
+	int ReadReply(Command_Entry* pEntry);
+	void SendEnvelopePipelined();
 	void InitOpenSSL();
 	void OpenSSLConnect();
 	void CleanupOpenSSL();
 	void ReceiveData_SSL(SSL* ssl, Command_Entry* pEntry);
 	void SendData_SSL(SSL* ssl, Command_Entry* pEntry);
+	void SendBytes_SSL(SSL* ssl, Command_Entry* pEntry, const char* data, int size);
+	void GatherRef(Command_Entry* pEntry, const char* data, size_t size);
+	void GatherCopy(Command_Entry* pEntry, const char* data, size_t size);
+	void GatherSendBuf(Command_Entry* pEntry);
+	void GatherFlush(Command_Entry* pEntry);
+	void GatherClear();
 	void StartTls();
 };
 
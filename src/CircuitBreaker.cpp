@@ -0,0 +1,171 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+* MIT License
+*
+* Copyright (c) 2017 Simon Carter (s1cart3r@gmail.com)
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*
+* The Original Code was created by Simon Carter (s1cart3r@gmail.com).
+*
+* Module:  fbSMTPUDF - Firebird UDF Library for sending emails.
+*
+* Description: Stops sending to a server which can not be reached, a single
+*			   probe connection is allowed through periodically.
+*
+* Date: 17/10/2026
+*
+*/
+
+
+#include "CircuitBreaker.h"
+
+namespace FBMailUDF
+{
+	CircuitBreaker::CircuitBreaker()
+		: state(CircuitState::Closed), consecutiveFailures(0), failureThreshold(DEFAULT_BREAKER_FAILURES), 
+		probeInterval(DEFAULT_BREAKER_PROBE_INTERVAL)
+	{
+
+	}
+
+	CircuitBreaker::~CircuitBreaker()
+	{
+
+	}
+
+	bool CircuitBreaker::allowRequest(bool &probe, std::chrono::steady_clock::time_point &available)
+	{
+		std::lock_guard<std::mutex> guard(breakerLock);
+
+		probe = false;
+		std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+		std::chrono::steady_clock::time_point probeTime = openedTime + std::chrono::seconds(probeInterval);
+
+		switch (state)
+		{
+			case CircuitState::Closed:
+				return (true);
+
+			case CircuitState::Open:
+				if (now >= probeTime)
+				{
+					state = CircuitState::HalfOpen;
+					probe = true;
+					return (true);
+				}
+
+				available = probeTime;
+				return (false);
+
+			default:
+				// the probe has not finished, nothing else is sent until it has
+				available = now + std::chrono::seconds(probeInterval);
+				return (false);
+		}
+	}
+
+	void CircuitBreaker::probeCancelled()
+	{
+		std::lock_guard<std::mutex> guard(breakerLock);
+
+		// the probe was not sent, the next request is allowed to probe instead
+		if (state == CircuitState::HalfOpen)
+			state = CircuitState::Open;
+	}
+
+	void CircuitBreaker::recordSuccess()
+	{
+		std::lock_guard<std::mutex> guard(breakerLock);
+
+		consecutiveFailures = 0;
+		state = CircuitState::Closed;
+	}
+
+	void CircuitBreaker::recordFailure()
+	{
+		std::lock_guard<std::mutex> guard(breakerLock);
+
+		consecutiveFailures++;
+
+		if (state == CircuitState::HalfOpen || consecutiveFailures >= failureThreshold)
+		{
+			state = CircuitState::Open;
+			openedTime = std::chrono::steady_clock::now();
+		}
+	}
+
+	CircuitState CircuitBreaker::getState()
+	{
+		std::lock_guard<std::mutex> guard(breakerLock);
+		return (state);
+	}
+
+	bool CircuitBreaker::isClosed()
+	{
+		return (getState() == CircuitState::Closed);
+	}
+
+	EMailResult CircuitBreaker::setFailureThreshold(const int value)
+	{
+		if (value < 1 || value > MAX_BREAKER_FAILURES)
+			return (EMailResult::InvalidOptionValue);
+
+		std::lock_guard<std::mutex> guard(breakerLock);
+		failureThreshold = value;
+
+		return (EMailResult::Success);
+	}
+
+	EMailResult CircuitBreaker::setProbeInterval(const int value)
+	{
+		if (value < 1 || value > MAX_BREAKER_PROBE_INTERVAL)
+			return (EMailResult::InvalidOptionValue);
+
+		std::lock_guard<std::mutex> guard(breakerLock);
+		probeInterval = value;
+
+		return (EMailResult::Success);
+	}
+
+	bool CircuitBreaker::isConnectionFailure(const ECSmtp &error)
+	{
+		// any reply from the server shows it can be reached
+		if (error.GetReplyCode() > 0)
+			return (false);
+
+		switch (error.GetErrorNum())
+		{
+			case ECSmtp::WSA_CONNECT:
+			case ECSmtp::WSA_GETHOSTBY_NAME_ADDR:
+			case ECSmtp::WSA_INVALID_SOCKET:
+			case ECSmtp::WSA_SEND:
+			case ECSmtp::WSA_RECV:
+			case ECSmtp::WSA_SELECT:
+			case ECSmtp::CONNECTION_CLOSED:
+			case ECSmtp::SERVER_NOT_READY:
+			case ECSmtp::SERVER_NOT_RESPONDING:
+			case ECSmtp::SELECT_TIMEOUT:
+			case ECSmtp::SSL_PROBLEM:
+				return (true);
+
+			default:
+				return (false);
+		}
+	}
+}
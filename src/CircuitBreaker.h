@@ -0,0 +1,89 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+* MIT License
+*
+* Copyright (c) 2017 Simon Carter (s1cart3r@gmail.com)
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*
+* The Original Code was created by Simon Carter (s1cart3r@gmail.com).
+*
+* Module:  fbSMTPUDF - Firebird UDF Library for sending emails.
+*
+* Description: Stops sending to a server which can not be reached, a single
+*			   probe connection is allowed through periodically.
+*
+* Date: 17/10/2026
+*
+*/
+
+
+#ifndef FB_SMTP__CIRCUIT_BREAKER
+#define FB_SMTP__CIRCUIT_BREAKER
+
+#include <mutex>
+#include <chrono>
+
+#include "Global.h"
+#include "CSmtp.h"
+
+namespace FBMailUDF
+{
+	enum CircuitState
+	{
+		Closed = 0,		// messages are sent normally
+		Open = 1,		// the server can not be reached, messages are held back
+		HalfOpen = 2	// a single probe is being sent to see if the server is back
+	};
+
+	// after a number of consecutive connection failures the circuit opens and no messages
+	// are sent to the server, once the probe interval has passed one batch is let through
+	// as a probe, if it connects the circuit closes otherwise it opens again
+	class CircuitBreaker
+	{
+	private:
+		std::mutex breakerLock;
+		CircuitState state;
+		int consecutiveFailures;
+		int failureThreshold;
+		int probeInterval;
+		std::chrono::steady_clock::time_point openedTime;
+
+		// prevent class copying
+		CircuitBreaker(const CircuitBreaker&);
+		CircuitBreaker& operator=(const CircuitBreaker&);
+	public:
+		CircuitBreaker();
+		~CircuitBreaker();
+
+		bool allowRequest(bool &probe, std::chrono::steady_clock::time_point &available);
+		void probeCancelled();
+		void recordSuccess();
+		void recordFailure();
+
+		CircuitState getState();
+		bool isClosed();
+
+		EMailResult setFailureThreshold(const int value);
+		EMailResult setProbeInterval(const int value);
+
+		static bool isConnectionFailure(const ECSmtp &error);
+	};
+}
+
+#endif
@@ -0,0 +1,98 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+* MIT License
+*
+* Copyright (c) 2017 Simon Carter (s1cart3r@gmail.com)
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*
+* The Original Code was created by Simon Carter (s1cart3r@gmail.com).
+*
+* Module:  fbSMTPUDF - Firebird UDF Library for sending emails.
+*
+* Description: Detects the SIMD instructions supported by the processor.
+*
+* Date: 17/10/2026
+*
+*/
+
+
+#include "CpuFeatures.h"
+
+#if defined(FB_SMTP_X86) && defined(_MSC_VER)
+	#include <intrin.h>
+	#include <immintrin.h>
+#endif
+
+namespace FBMailUDF
+{
+	struct DetectedFeatures
+	{
+		bool sse2;
+		bool ssse3;
+		bool avx2;
+
+		DetectedFeatures()
+			: sse2(false), ssse3(false), avx2(false)
+		{
+#if defined(FB_SMTP_X86) && defined(_MSC_VER)
+			int info[4];
+			__cpuid(info, 1);
+
+			sse2 = (info[3] & (1 << 26)) != 0;
+			ssse3 = (info[2] & (1 << 9)) != 0;
+
+			// avx2 also needs the operating system to save the ymm registers
+			bool osSavesYmm = (info[2] & (1 << 27)) != 0 && (info[2] & (1 << 28)) != 0 && 
+				(_xgetbv(0) & 6) == 6;
+
+			if (osSavesYmm)
+			{
+				__cpuidex(info, 7, 0);
+				avx2 = (info[1] & (1 << 5)) != 0;
+			}
+#elif defined(FB_SMTP_X86) && (defined(__GNUC__) || defined(__clang__))
+			__builtin_cpu_init();
+			sse2 = __builtin_cpu_supports("sse2") != 0;
+			ssse3 = __builtin_cpu_supports("ssse3") != 0;
+			avx2 = __builtin_cpu_supports("avx2") != 0;
+#endif
+		}
+	};
+
+	const DetectedFeatures &getFeatures()
+	{
+		static const DetectedFeatures features;
+		return (features);
+	}
+
+	bool CpuFeatures::hasSSE2()
+	{
+		return (getFeatures().sse2);
+	}
+
+	bool CpuFeatures::hasSSSE3()
+	{
+		return (getFeatures().ssse3);
+	}
+
+	bool CpuFeatures::hasAVX2()
+	{
+		return (getFeatures().avx2);
+	}
+}
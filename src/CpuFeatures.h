@@ -0,0 +1,62 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+* MIT License
+*
+* Copyright (c) 2017 Simon Carter (s1cart3r@gmail.com)
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*
+* The Original Code was created by Simon Carter (s1cart3r@gmail.com).
+*
+* Module:  fbSMTPUDF - Firebird UDF Library for sending emails.
+*
+* Description: Detects the SIMD instructions supported by the processor.
+*
+* Date: 17/10/2026
+*
+*/
+
+
+#ifndef FB_SMTP__CPU_FEATURES
+#define FB_SMTP__CPU_FEATURES
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+	#define FB_SMTP_X86
+#endif
+
+// functions using instructions beyond the compiler's default are marked with the
+// instruction set, msvc allows the intrinsics without it
+#if defined(__GNUC__) || defined(__clang__)
+	#define FB_SMTP_TARGET(isa) __attribute__((target(isa)))
+#else
+	#define FB_SMTP_TARGET(isa)
+#endif
+
+namespace FBMailUDF
+{
+	// features are detected once, the first time they are requested
+	class CpuFeatures
+	{
+	public:
+		static bool hasSSE2();
+		static bool hasSSSE3();
+		static bool hasAVX2();
+	};
+}
+
+#endif
@@ -40,6 +40,7 @@
 #include <vector>
 #include <list>
 #include <stdint.h>
+#include <memory>
 
 #include "ManagedThread.h"
 
@@ -52,10 +53,37 @@ namespace FBMailUDF
 
 	const int MIN_SUBJECT_LENGTH = 10;				// minimum mail subject length
 	const int MAX_SERVER_STRING_LENGHT = 100;		// max length of server name/user/pass
-	const int MAIL_SEND_DELAY = 200;				// 200 ms between each mail sent
-	const int THREAD_RUN_INTERVAL_SECONDS = 10000;	// send thread runs every 10 seconds
+	const int THREAD_RUN_INTERVAL_SECONDS = 10000;	// send threads are woken when queued, otherwise run every 10 seconds
 	const int MAX_ERROR_MESSAGE_LENGTH = 300;		// maximum length of an error message
 	const int MAX_SLEEP_DELAY = 1000;				// maximum sleep delay when checking message count
+	const int SMTP_POOL_IDLE_TIMEOUT = 60;			// seconds an idle smtp session is kept open for reuse
+	const int SMTP_POOL_MAX_IDLE = 4;				// maximum idle smtp sessions kept open per server
+	const size_t MAX_MESSAGES_PER_SESSION = 100;	// maximum queued messages sent over one session in a batch
+	const int DATABASE_QUANTUM = 100;				// messages a database with a weight of 1 can send in each round
+	const int DEFAULT_DATABASE_WEIGHT = 1;			// share of sending given to each database
+	const int MAX_DATABASE_WEIGHT = 100;			// maximum weight which can be given to a database
+	const int DEFAULT_GROUP_WINDOW = 250;			// ms a queued message is held so others for the same server can join it
+	const int MAX_GROUP_WINDOW = 10000;				// maximum group window which can be set
+	const size_t MAX_RECIPIENTS_PER_TRANSACTION = 100;	// most recipients sent identical content in one transaction
+	const int DEFAULT_ATTACHMENT_CACHE_SIZE = 64;	// MB of encoded attachments kept for messages sending the same file
+	const int MAX_ATTACHMENT_CACHE_SIZE = 1024;		// maximum attachment cache size which can be set
+	const int DEFAULT_SEND_THREAD_COUNT = 4;		// number of threads sending queued messages
+	const int MAX_SEND_THREAD_COUNT = 32;			// maximum number of threads sending queued messages
+	const int SEND_THREAD_STOP_TIMEOUT = 5000;		// ms send threads are given to stop when the library is unloaded
+	const int INITIAL_SERVER_SESSIONS = 2;			// concurrent send sessions per server before the limit adapts
+	const int DEFAULT_SERVER_MAX_SESSIONS = 8;		// most concurrent send sessions the limit can grow to per server
+	const int MAX_SERVER_SESSIONS = 32;				// maximum concurrent send sessions that can be set per server
+	const int RESULT_STORE_TTL = 86400;				// seconds a send result is kept if it is not erased
+	const size_t RESULT_STORE_CAPACITY = 100000;	// maximum send results kept, oldest are removed first
+	const int DEFAULT_SERVER_RATE_BURST = 10;		// messages which can be sent together when a server has a rate limit
+	const int DEFAULT_RETRY_LIMIT = 3;				// times a message is retried after a transient failure
+	const int MAX_RETRY_LIMIT = 10;					// maximum retry limit which can be set
+	const int DEFAULT_RETRY_DELAY = 30;				// seconds before the first retry, doubled for each retry after
+	const int MAX_RETRY_DELAY = 3600;				// longest delay in seconds before a message is retried
+	const int DEFAULT_BREAKER_FAILURES = 5;			// consecutive connection failures before sending to a server stops
+	const int MAX_BREAKER_FAILURES = 100;			// maximum connection failures which can be set
+	const int DEFAULT_BREAKER_PROBE_INTERVAL = 60;	// seconds between probe connections to a server which can not be reached
+	const int MAX_BREAKER_PROBE_INTERVAL = 3600;	// maximum probe interval which can be set
 
 	enum EMailResult
 	{
@@ -89,9 +117,64 @@ namespace FBMailUDF
 
 		InvalidMessageBuffer = -14,
 
+		InvalidStatistic = -15,
+
+		InvalidOption = -16,
+
+		InvalidOptionValue = -17,
+
+		RateLimited = -18,
+
+		ServerUnavailable = -19,
+
 		GeneralError = -999
 	};
 
+	enum EMailStatistic
+	{
+		TlsFullHandshakes = 0,
+
+		TlsResumedHandshakes = 1,
+
+		AttachmentCacheHits = 2,
+
+		AttachmentCacheMisses = 3,
+
+		AttachmentCacheHitRate = 4,
+
+		AttachmentCacheBytesSaved = 5
+	};
+
+	enum EMailOption
+	{
+		SendThreadCount = 0,
+
+		RetryLimit = 1,
+
+		RetryDelay = 2,
+
+		GroupWindow = 3,
+
+		CombineRecipients = 4,
+
+		AttachmentCacheSize = 5
+	};
+
+	enum EServerOption
+	{
+		MaxSessions = 0,
+
+		RateBurst = 1,
+
+		RatePerMinute = 2,
+
+		DailyQuota = 3,
+
+		BreakerFailures = 4,
+
+		BreakerProbeInterval = 5
+	};
+
 	class MailMessage;
 	class MailServer;
 	class MailSendNotification;
@@ -99,6 +182,7 @@ namespace FBMailUDF
 
 	typedef std::vector<MailMessage> MailMessageList;
 	typedef std::vector<MailServer> MailServerList;
+	typedef std::shared_ptr<const MailServer> MailServerHandle;
 	typedef std::vector<MailSendNotification*> MailSendNotificationList;
 	typedef std::vector<MailSendResult> MailSendResultList;
 }
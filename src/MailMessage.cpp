@@ -32,28 +32,47 @@
 */
 
 
+#include <cstring>
+#include <algorithm>
+
 #include "MailMessage.h"
 
 
 namespace FBMailUDF
 {
 	MailMessage::MailMessage()
+		: fieldEnd(), id(0), priority(CSmptXPriority::XPRIORITY_NORMAL), deadline(0), sequence(0), attempts(0), sent(false), sendTime(0)
 	{
 	
 	}
 	
-	MailMessage::MailMessage(MailServer &server, const FB_BIGINT id, const std::string &sendName, const std::string &sendEmail,
+	MailMessage::MailMessage(const MailServerHandle &server, const FB_BIGINT id, const std::string &sendName, const std::string &sendEmail,
 		const std::string &recName,	const std::string &recEmail, const std::string &subj, const std::string &msg, 
 		const int priority)
+		: MailMessage()
 	{
 		mailServer = server;
 		this->id = id;
-		senderName = sendName;
-		senderEmail = sendEmail;
-		recipientName = recName;
-		recipientEmail = recEmail;
-		subject = subj;
-		message = msg;
+
+		// if no name is given for the sender or recipient their email is used
+		const std::string *fields[FieldCount] = { sendName.empty() ? &sendEmail : &sendName, &sendEmail, 
+			recName.empty() ? &recEmail : &recName, &recEmail, &subj, &msg };
+
+		size_t length = 0;
+
+		for (int i = 0; i < FieldCount; i++)
+			length += fields[i]->size() + 1;
+
+		text.reset(new char[length]);
+		uint32_t offset = 0;
+
+		for (int i = 0; i < FieldCount; i++)
+		{
+			memcpy(text.get() + offset, fields[i]->data(), fields[i]->size());
+			offset += static_cast<uint32_t>(fields[i]->size());
+			text[offset++] = '\0';
+			fieldEnd[i] = offset;
+		}
 
 		switch (priority)
 		{
@@ -62,12 +81,19 @@ namespace FBMailUDF
 			break;
 		case 0:
 			this->priority = CSmptXPriority::XPRIORITY_LOW;
+			break;
 		default:
 			this->priority = CSmptXPriority::XPRIORITY_NORMAL;
 			break;
 		}
+	}
 
-		sent = false;
+	MailMessage::MailMessage(const MailServerHandle &server, const FB_BIGINT id, const std::string &sendName, const std::string &sendEmail,
+		const std::string &recName, const std::string &recEmail, const std::string &subj, const std::string &msg,
+		const int priority, const time_t deadline)
+		: MailMessage(server, id, sendName, sendEmail, recName, recEmail, subj, msg, priority)
+	{
+		this->deadline = deadline;
 	}
 
 	MailMessage::~MailMessage()
@@ -75,47 +101,104 @@ namespace FBMailUDF
 
 	}
 
-	FB_BIGINT MailMessage::getMessageID()
+	std::string_view MailMessage::getField(const TextField field) const
+	{
+		if (!text)
+			return (std::string_view());
+
+		uint32_t start = field == 0 ? 0 : fieldEnd[field - 1];
+
+		// the null terminator is not part of the view
+		return (std::string_view(text.get() + start, fieldEnd[field] - start - 1));
+	}
+
+	FB_BIGINT MailMessage::getMessageID() const
 	{
 		return (id);
 	}
 
-	std::string MailMessage::getSenderName()
+	std::string_view MailMessage::getSenderName() const
+	{
+		return (getField(TextField::SenderName));
+	}
+
+	std::string_view MailMessage::getSenderEmail() const
 	{
-		return (senderName);
+		return (getField(TextField::SenderEmail));
 	}
 
-	std::string MailMessage::getSenderEmail()
+	std::string_view MailMessage::getRecipientName() const
 	{
-		return (senderEmail);
+		return (getField(TextField::RecipientName));
 	}
 
-	std::string MailMessage::getRecipientName()
+	std::string_view MailMessage::getRecipientEmail() const
 	{
-		return (recipientName);
+		return (getField(TextField::RecipientEmail));
 	}
 
-	std::string MailMessage::getRecipientEmail()
+	std::string_view MailMessage::getSubject() const
 	{
-		return (recipientEmail);
+		return (getField(TextField::Subject));
 	}
 
-	std::string MailMessage::getSubject()
+	std::string_view MailMessage::getMessage() const
 	{
-		return (subject);
+		return (getField(TextField::Message));
 	}
 
-	std::string MailMessage::getMessage()
+	std::string_view MailMessage::getRecipientDomain() const
 	{
-		return (message);
+		std::string_view email = getRecipientEmail();
+		size_t at = email.rfind('@');
+
+		if (at == std::string_view::npos)
+			return (std::string_view());
+
+		return (email.substr(at + 1));
 	}
 
-	CSmptXPriority MailMessage::getPriority()
+	CSmptXPriority MailMessage::getPriority() const
 	{
 		return (priority);
 	}
 
-	MailServer MailMessage::getMailServer()
+	time_t MailMessage::getDeadline() const
+	{
+		return (deadline);
+	}
+
+	uint64_t MailMessage::getSequence() const
+	{
+		return (sequence);
+	}
+
+	void MailMessage::setSequence(const uint64_t value)
+	{
+		sequence = value;
+	}
+
+	int MailMessage::getAttempts() const
+	{
+		return (attempts);
+	}
+
+	void MailMessage::attemptFailed()
+	{
+		attempts++;
+	}
+
+	const std::chrono::steady_clock::time_point &MailMessage::getQueuedTime() const
+	{
+		return (queuedTime);
+	}
+
+	void MailMessage::setQueuedTime(const std::chrono::steady_clock::time_point &value)
+	{
+		queuedTime = value;
+	}
+
+	const MailServerHandle &MailMessage::getMailServer() const
 	{
 		return (mailServer);
 	}
@@ -126,8 +209,13 @@ namespace FBMailUDF
 		time(&sendTime);
 	}
 
-	EMailResult MailMessage::canSend()
+	EMailResult MailMessage::canSend() const
 	{
+		std::string_view message = getMessage();
+		std::string_view senderEmail = getSenderEmail();
+		std::string_view recipientEmail = getRecipientEmail();
+		std::string_view subject = getSubject();
+
 		// a few basic validation checks on the message
 		if (message.empty())
 			return (EMailResult::InvalidContent);
@@ -138,40 +226,43 @@ namespace FBMailUDF
 		if (recipientEmail.empty())
 			return (EMailResult::InvalidRecipientEmail);
 
-		std::regex emailCheck = std::regex("^[_a-z0-9-]+(\\.[_a-z0-9-]+)*@[a-z0-9-]+(\\.[a-z0-9-]+)*(\\.[a-z]{2,4})$");
+		static const std::regex emailCheck = std::regex("^[_a-z0-9-]+(\\.[_a-z0-9-]+)*@[a-z0-9-]+(\\.[a-z0-9-]+)*(\\.[a-z]{2,4})$");
 
-		if (!regex_match(senderEmail.cbegin(), senderEmail.cend(), emailCheck))
+		if (!regex_match(senderEmail.data(), senderEmail.data() + senderEmail.size(), emailCheck))
 			return (EMailResult::InvalidSenderEmail);
 
-		if (!regex_match(recipientEmail.cbegin(), recipientEmail.cend(), emailCheck))
+		if (!regex_match(recipientEmail.data(), recipientEmail.data() + recipientEmail.size(), emailCheck))
 			return (EMailResult::InvalidRecipientEmail);
 
 		if (subject.empty() || subject.size() < MIN_SUBJECT_LENGTH)
 			return (EMailResult::InvalidSubject);
 
-		if (senderName.empty())
-			senderName = senderEmail;
-
-		if (recipientName.empty())
-			recipientName = recipientEmail;
-
 		return (EMailResult::Success);
 	}
 
-	bool MailMessage::isHTML()
+	bool MailMessage::isHTML() const
 	{
-		std::string start = message.substr(0, 6);
+		std::string start = std::string(getMessage().substr(0, 6));
 		std::transform(start.cbegin(), start.cend(), start.begin(), ::tolower);
 		return (start.compare("<html>") == 0);
 	}
 
-	bool MailMessage::isSent()
+	bool MailMessage::isSent() const
 	{
 		return (sent);
 	}
 
-	time_t MailMessage::sendDateTime()
+	time_t MailMessage::sendDateTime() const
 	{
 		return (sendTime);
 	}
+
+	bool MailMessage::hasSameContent(const MailMessage &value) const
+	{
+		// everything apart from the recipient, the recipient name is only used in
+		// the To header which is not sent when recipients share a transaction
+		return (priority == value.priority && *mailServer == *value.mailServer &&
+			getSenderEmail() == value.getSenderEmail() && getSenderName() == value.getSenderName() &&
+			getSubject() == value.getSubject() && getMessage() == value.getMessage());
+	}
 }
@@ -36,6 +36,9 @@
 #define FB_SMTP__MAIL_MESSAGE
 
 #include <regex>
+#include <memory>
+#include <string_view>
+#include <chrono>
 
 #include "CSmtp.h"
 #include "Global.h"
@@ -43,47 +46,80 @@
 
 namespace FBMailUDF
 {
+	// all of the text for a message is held in a single buffer, each field is
+	// followed by a null terminator so the views can be passed on as c strings
 	class MailMessage
 	{
-		FB_BIGINT id;
-		std::string senderName;
-		std::string senderEmail;
-		std::string recipientName;
-		std::string recipientEmail;
+	private:
+		enum TextField
+		{
+			SenderName = 0,
+			SenderEmail,
+			RecipientName,
+			RecipientEmail,
+			Subject,
+			Message,
+			FieldCount
+		};
 
-		std::string subject;
-		std::string message;
+		std::unique_ptr<char[]> text;
+		uint32_t fieldEnd[FieldCount];
 
+		FB_BIGINT id;
 		CSmptXPriority priority;
+		time_t deadline;
+		uint64_t sequence;
+		int attempts;
+		std::chrono::steady_clock::time_point queuedTime;
 
 		bool sent;
 		time_t sendTime;
-		MailServer mailServer;
+		MailServerHandle mailServer;
+
+		std::string_view getField(const TextField field) const;
 	public:
 		MailMessage();
-		MailMessage(MailServer &server, const FB_BIGINT id, const std::string &sendName, const std::string &sendEmail, 
+		MailMessage(const MailServerHandle &server, const FB_BIGINT id, const std::string &sendName, const std::string &sendEmail, 
 			const std::string &recName, const std::string &recEmail, const std::string &subj, const std::string &msg, 
 			const int priority);
+		MailMessage(const MailServerHandle &server, const FB_BIGINT id, const std::string &sendName, const std::string &sendEmail, 
+			const std::string &recName, const std::string &recEmail, const std::string &subj, const std::string &msg, 
+			const int priority, const time_t deadline);
+		MailMessage(MailMessage &&value) = default;
+		MailMessage& operator=(MailMessage &&value) = default;
 		~MailMessage();
 
 		// property wrappers
-		FB_BIGINT getMessageID();
-		std::string getSenderName();
-		std::string getSenderEmail();
-		std::string getRecipientName();
-		std::string getRecipientEmail();
-		std::string getSubject();
-		std::string getMessage();
-		CSmptXPriority getPriority();
-		MailServer getMailServer();
+		FB_BIGINT getMessageID() const;
+		std::string_view getSenderName() const;
+		std::string_view getSenderEmail() const;
+		std::string_view getRecipientName() const;
+		std::string_view getRecipientEmail() const;
+		std::string_view getSubject() const;
+		std::string_view getMessage() const;
+		std::string_view getRecipientDomain() const;
+		CSmptXPriority getPriority() const;
+		time_t getDeadline() const;
+		uint64_t getSequence() const;
+		void setSequence(const uint64_t value);
+		int getAttempts() const;
+		void attemptFailed();
+		const std::chrono::steady_clock::time_point &getQueuedTime() const;
+		void setQueuedTime(const std::chrono::steady_clock::time_point &value);
+		const MailServerHandle &getMailServer() const;
 
 		void messageSent();
-		bool isSent();
-		time_t sendDateTime();
+		bool isSent() const;
+		time_t sendDateTime() const;
 
 		//general
-		EMailResult canSend();
-		bool isHTML();
+		EMailResult canSend() const;
+		bool isHTML() const;
+		bool hasSameContent(const MailMessage &value) const;
+
+		// messages are moved, never copied
+		MailMessage(const MailMessage&) = delete;
+		MailMessage& operator=(const MailMessage&) = delete;
 	};
 }
 
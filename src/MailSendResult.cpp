@@ -32,10 +32,70 @@
 */
 
 
+#include <mutex>
+#include <unordered_map>
+
 #include "MailSendResult.h"
 
 namespace FBMailUDF
 {
+	// the same error text is reported for many messages, each distinct text is
+	// held once and shared by every result reporting it
+	typedef std::unordered_map<std::string, std::weak_ptr<const std::string>> ErrorTextMap;
+
+	size_t errorTextPruneSize = 64;
+
+	// created on first use and never destroyed, a send thread still finishing a message
+	// when the library is unloaded can report its result after static destruction
+	static std::mutex& errorTextLockMutex()
+	{
+		static std::mutex *Result = new std::mutex();
+		return (*Result);
+	}
+
+	static ErrorTextMap& errorTexts()
+	{
+		static ErrorTextMap *Result = new ErrorTextMap();
+		return (*Result);
+	}
+
+	std::shared_ptr<const std::string> internErrorText(const std::string &text)
+	{
+		static const std::shared_ptr<const std::string> &noError = 
+			*new std::shared_ptr<const std::string>(std::make_shared<const std::string>());
+
+		if (text.empty())
+			return (noError);
+
+		std::lock_guard<std::mutex> guard(errorTextLockMutex());
+
+		std::weak_ptr<const std::string> &entry = errorTexts()[text];
+		std::shared_ptr<const std::string> Result = entry.lock();
+
+		if (!Result)
+		{
+			Result = std::make_shared<const std::string>(text);
+			entry = Result;
+		}
+
+		// texts no longer used by any result are removed as the table grows
+		if (errorTexts().size() >= errorTextPruneSize)
+		{
+			for (ErrorTextMap::iterator it = errorTexts().begin(); 
+				it != errorTexts().end();)
+			{
+				if (it->second.expired())
+					it = errorTexts().erase(it);
+				else
+					it++;
+			}
+
+			errorTextPruneSize = errorTexts().size() * 2 > 64 ? errorTexts().size() * 2 : 64;
+		}
+
+		return (Result);
+	}
+
 	MailSendResult::MailSendResult(FB_BIGINT message, FB_BIGINT server, EMailResult result)
 	{
 		time(&resultTime);
@@ -43,7 +103,7 @@ namespace FBMailUDF
 		messageID = message;
 		serverID = server;
 		sendResult = result;
-		errorMessage = "";
+		errorMessage = internErrorText("");
 		errorCode = 0;
 	}
 
@@ -51,11 +111,8 @@ namespace FBMailUDF
 		std::string errorMessage, int errorCode)
 		: MailSendResult(message, server, result)
 	{
-		time(&resultTime);
-
-		messageID = message;
-		serverID = server;
-		sendResult = result;
+		this->errorMessage = internErrorText(errorMessage);
+		this->errorCode = errorCode;
 	}
 
 
@@ -68,6 +125,11 @@ namespace FBMailUDF
 		return (messageID);
 	}
 
+	void MailSendResult::setMessageID(FB_BIGINT message)
+	{
+		messageID = message;
+	}
+
 	FB_BIGINT MailSendResult::getServerID()
 	{
 		return (serverID);
@@ -90,12 +152,12 @@ namespace FBMailUDF
 
 	std::string MailSendResult::getErrorMessage()
 	{
-		return (errorMessage);
+		return (*errorMessage);
 	}
 
 	void MailSendResult::setErrorMessage(std::string message)
 	{
-		errorMessage = message;
+		errorMessage = internErrorText(message);
 	}
 
 	int MailSendResult::getErrorCode()
@@ -35,6 +35,8 @@
 #ifndef FB_SMTP__MAIL_SENDRESULT
 #define FB_SMTP__MAIL_SENDRESULT
 
+#include <memory>
+
 #include "Global.h"
 
 namespace FBMailUDF
@@ -45,7 +47,7 @@ namespace FBMailUDF
 		FB_BIGINT serverID;
 		EMailResult sendResult;
 		time_t resultTime;
-		std::string errorMessage;
+		std::shared_ptr<const std::string> errorMessage;
 		int errorCode;
 	public:
 		MailSendResult(FB_BIGINT message, FB_BIGINT server, EMailResult result, std::string errorMessage, int errorCode);
@@ -53,6 +55,7 @@ namespace FBMailUDF
 		~MailSendResult();
 
 		FB_BIGINT getMessageID();
+		void setMessageID(FB_BIGINT message);
 		FB_BIGINT getServerID();
 		time_t getResultTime();
 		EMailResult getSendResult();
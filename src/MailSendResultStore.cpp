@@ -0,0 +1,152 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+* MIT License
+*
+* Copyright (c) 2017 Simon Carter (s1cart3r@gmail.com)
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*
+* The Original Code was created by Simon Carter (s1cart3r@gmail.com).
+*
+* Module:  fbSMTPUDF - Firebird UDF Library for sending emails.
+*
+* Description: Send results waiting to be read, indexed by server and message
+*			   id, removed once too old or when the store is full.
+*
+* Date: 17/10/2026
+*
+*/
+
+
+#include "MailSendResultStore.h"
+
+namespace FBMailUDF
+{
+	bool MailSendResultStore::ResultKey::operator ==(const ResultKey &value) const
+	{
+		return (serverID == value.serverID && messageID == value.messageID);
+	}
+
+	size_t MailSendResultStore::ResultKeyHash::operator()(const ResultKey &value) const
+	{
+		std::hash<FB_BIGINT> hasher;
+		size_t Result = hasher(value.serverID);
+
+		return (Result ^ (hasher(value.messageID) + 0x9e3779b9 + (Result << 6) + (Result >> 2)));
+	}
+
+	MailSendResultStore::MailSendResultStore()
+		: MailSendResultStore(std::chrono::seconds(RESULT_STORE_TTL), RESULT_STORE_CAPACITY)
+	{
+
+	}
+
+	MailSendResultStore::MailSendResultStore(const std::chrono::seconds ttl, const size_t maximumResults)
+		: nextSequence(0), timeToLive(ttl), capacity(maximumResults)
+	{
+
+	}
+
+	MailSendResultStore::~MailSendResultStore()
+	{
+
+	}
+
+	void MailSendResultStore::removeExpired(const std::chrono::steady_clock::time_point now)
+	{
+		// ages are held in the order results were added, an age is out of date if 
+		// the result has since been erased or replaced by a newer result
+		while (resultAges.size() > 0)
+		{
+			ResultAge &oldest = resultAges.front();
+			ResultMap::iterator it = results.find(oldest.key);
+			bool current = it != results.end() && it->second.sequence == oldest.sequence;
+
+			if (current && now - oldest.added < timeToLive && 
+				results.size() <= capacity && resultAges.size() <= capacity * 2)
+			{
+				break;
+			}
+
+			if (current)
+				results.erase(it);
+
+			resultAges.pop_front();
+		}
+	}
+
+	void MailSendResultStore::add(MailSendResult &result)
+	{
+		ResultKey key;
+		key.serverID = result.getServerID();
+		key.messageID = result.getMessageID();
+
+		ResultAge age;
+		age.key = key;
+		age.added = std::chrono::steady_clock::now();
+
+		std::lock_guard<std::mutex> guard(storeLock);
+
+		age.sequence = ++nextSequence;
+
+		StoredResult stored = { result, age.sequence };
+
+		// if the same message is sent more than once the latest result is kept
+		ResultMap::iterator it = results.find(key);
+
+		if (it != results.end())
+			it->second = stored;
+		else
+			results.insert(ResultMap::value_type(key, stored));
+
+		resultAges.push_back(age);
+
+		removeExpired(age.added);
+	}
+
+	EMailResult MailSendResultStore::find(const FB_BIGINT serverID, const FB_BIGINT messageID, const bool erase,
+		std::string &errorMessage, int &errorCode)
+	{
+		ResultKey key;
+		key.serverID = serverID;
+		key.messageID = messageID;
+
+		std::lock_guard<std::mutex> guard(storeLock);
+
+		ResultMap::iterator it = results.find(key);
+
+		if (it == results.end())
+			return (EMailResult::NotFound);
+
+		EMailResult Result = it->second.result.getSendResult();
+		errorMessage = it->second.result.getErrorMessage();
+		errorCode = it->second.result.getErrorCode();
+
+		// the age is left in place and discarded when it reaches the front
+		if (erase)
+			results.erase(it);
+
+		return (Result);
+	}
+
+	size_t MailSendResultStore::size()
+	{
+		std::lock_guard<std::mutex> guard(storeLock);
+		return (results.size());
+	}
+}
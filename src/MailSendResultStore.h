@@ -0,0 +1,107 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+* MIT License
+*
+* Copyright (c) 2017 Simon Carter (s1cart3r@gmail.com)
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*
+* The Original Code was created by Simon Carter (s1cart3r@gmail.com).
+*
+* Module:  fbSMTPUDF - Firebird UDF Library for sending emails.
+*
+* Description: Send results waiting to be read, indexed by server and message
+*			   id, removed once too old or when the store is full.
+*
+* Date: 17/10/2026
+*
+*/
+
+
+#ifndef FB_SMTP__MAIL_SENDRESULT_STORE
+#define FB_SMTP__MAIL_SENDRESULT_STORE
+
+#include <mutex>
+#include <deque>
+#include <unordered_map>
+#include <chrono>
+
+#include "Global.h"
+#include "MailSendResult.h"
+
+namespace FBMailUDF
+{
+	class MailSendResultStore
+	{
+	private:
+		struct ResultKey
+		{
+			FB_BIGINT serverID;
+			FB_BIGINT messageID;
+
+			bool operator ==(const ResultKey &value) const;
+		};
+
+		struct ResultKeyHash
+		{
+			size_t operator()(const ResultKey &value) const;
+		};
+
+		// each result is numbered in the order it was added, an age only applies to the 
+		// result with the same number, so a result replaced within the same second is 
+		// not mistaken for the one it replaced
+		struct StoredResult
+		{
+			MailSendResult result;
+			unsigned long long sequence;
+		};
+
+		struct ResultAge
+		{
+			ResultKey key;
+			unsigned long long sequence;
+			std::chrono::steady_clock::time_point added;
+		};
+
+		typedef std::unordered_map<ResultKey, StoredResult, ResultKeyHash> ResultMap;
+
+		ResultMap results;
+		std::deque<ResultAge> resultAges;
+		unsigned long long nextSequence;
+		std::chrono::seconds timeToLive;
+		size_t capacity;
+		std::mutex storeLock;
+
+		void removeExpired(const std::chrono::steady_clock::time_point now);
+
+		// prevent class copying
+		MailSendResultStore(const MailSendResultStore&);
+		MailSendResultStore& operator=(const MailSendResultStore&);
+	public:
+		MailSendResultStore();
+		MailSendResultStore(const std::chrono::seconds ttl, const size_t maximumResults);
+		~MailSendResultStore();
+
+		void add(MailSendResult &result);
+		EMailResult find(const FB_BIGINT serverID, const FB_BIGINT messageID, const bool erase,
+			std::string &errorMessage, int &errorCode);
+		size_t size();
+	};
+}
+
+#endif
@@ -37,6 +37,7 @@
 namespace FBMailUDF
 {
 	MailServer::MailServer()
+		: state(std::make_shared<MailServerState>())
 	{
 
 	}
@@ -52,6 +53,7 @@ namespace FBMailUDF
 	MailServer::MailServer(const FB_BIGINT serverID, const std::string &serverName, const PortNumber port, 
 		SMTP_SECURITY_TYPE securityType, const std::string &userName, const std::string &password,
 		const std::string &dbase)
+		: state(std::make_shared<MailServerState>())
 	{
 		this->serverName = serverName;
 		this->port = port;
@@ -64,12 +66,18 @@ namespace FBMailUDF
 		this->serverID = static_cast<FB_BIGINT>(serverID);
 	}
 
+	MailServer::MailServer(const FB_BIGINT serverID, const MailServer &server)
+		: MailServer(server)
+	{
+		this->serverID = serverID;
+	}
+
 	MailServer::~MailServer()
 	{
 
 	}
 
-	bool MailServer::operator==(const MailServer &value)
+	bool MailServer::operator==(const MailServer &value) const
 	{
 		return (value.port == port && value.securityType == securityType &&
 			value.serverName.compare(serverName) == 0 &&
@@ -77,47 +85,52 @@ namespace FBMailUDF
 			value.password.compare(password) == 0);
 	}
 
-	std::string MailServer::getServerName()
+	const std::string &MailServer::getServerName() const
 	{
 		return (serverName);
 	}
 
-	PortNumber MailServer::getPortNumber()
+	PortNumber MailServer::getPortNumber() const
 	{
 		return (port);
 	}
 
-	SMTP_SECURITY_TYPE MailServer::getSecurityType()
+	SMTP_SECURITY_TYPE MailServer::getSecurityType() const
 	{
 		return (securityType);
 	}
 
-	std::string MailServer::getUserName()
+	const std::string &MailServer::getUserName() const
 	{
 		return (userName);
 	}
 
-	std::string MailServer::getUserPassword()
+	const std::string &MailServer::getUserPassword() const
 	{
 		return (password);
 	}
 
-	std::string MailServer::getXMailer()
+	const std::string &MailServer::getXMailer() const
 	{
 		return (xMailer);
 	}
 
-	FB_BIGINT MailServer::getServerID()
+	FB_BIGINT MailServer::getServerID() const
 	{
 		return (serverID);
 	}
 
-	std::string MailServer::getDatabase()
+	const std::string &MailServer::getDatabase() const
 	{
 		return (database);
 	}
 
-	EMailResult MailServer::isValidServer()
+	std::shared_ptr<MailServerState> MailServer::getState() const
+	{
+		return (state);
+	}
+
+	EMailResult MailServer::isValidServer() const
 	{
 		if (database.empty())
 			return (EMailResult::InvalidDatabaseName);
@@ -35,8 +35,11 @@
 #ifndef FB_SMTP__MAIL_SERVER
 #define FB_SMTP__MAIL_SERVER
 
+#include <memory>
+
 #include "Global.h"
 #include "CSmtp.h"
+#include "MailServerState.h"
 
 namespace FBMailUDF
 {
@@ -51,6 +54,7 @@ namespace FBMailUDF
 		unsigned short port;
 		std::string xMailer;
 		FB_BIGINT serverID;
+		std::shared_ptr<MailServerState> state;
 	public:
 		MailServer();
 		MailServer(const FB_BIGINT serverID, const std::string &serverName, const PortNumber port, 
@@ -59,20 +63,22 @@ namespace FBMailUDF
 		MailServer(const FB_BIGINT serverID, const std::string &serverName, const PortNumber port, 
 			SMTP_SECURITY_TYPE securityType, const std::string &userName, const std::string &password,
 			const std::string &dbase);
+		MailServer(const FB_BIGINT serverID, const MailServer &server);
 		~MailServer();
 
-		bool operator ==(const MailServer& value);
+		bool operator ==(const MailServer& value) const;
 
-		std::string getServerName();
-		PortNumber getPortNumber();
-		SMTP_SECURITY_TYPE getSecurityType();
-		std::string getUserName();
-		std::string getUserPassword();
-		std::string getXMailer();
-		FB_BIGINT getServerID();
-		std::string getDatabase();
+		const std::string &getServerName() const;
+		PortNumber getPortNumber() const;
+		SMTP_SECURITY_TYPE getSecurityType() const;
+		const std::string &getUserName() const;
+		const std::string &getUserPassword() const;
+		const std::string &getXMailer() const;
+		FB_BIGINT getServerID() const;
+		const std::string &getDatabase() const;
+		std::shared_ptr<MailServerState> getState() const;
 
-		EMailResult isValidServer();
+		EMailResult isValidServer() const;
 	};
 
 }
@@ -0,0 +1,104 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+* MIT License
+*
+* Copyright (c) 2017 Simon Carter (s1cart3r@gmail.com)
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*
+* The Original Code was created by Simon Carter (s1cart3r@gmail.com).
+*
+* Module:  fbSMTPUDF - Firebird UDF Library for sending emails.
+*
+* Description: Registered mail servers, read without locking through an
+*			   immutable snapshot which is replaced whenever a server is added or removed.
+*
+* Date: 17/10/2026
+*
+*/
+
+
+#include "MailServerRegistry.h"
+
+namespace FBMailUDF
+{
+	MailServerRegistry::MailServerRegistry()
+		: servers(std::make_shared<const MailServerMap>())
+	{
+		// ids continue on from the time the library was loaded so they are not 
+		// reused by servers added after the library is reloaded
+		nextServerID = static_cast<FB_BIGINT>(time(NULL));
+	}
+
+	MailServerRegistry::~MailServerRegistry()
+	{
+
+	}
+
+	FB_BIGINT MailServerRegistry::add(const MailServer &server)
+	{
+		std::lock_guard<std::mutex> guard(writeLock);
+
+		std::shared_ptr<const MailServerMap> current = std::atomic_load(&servers);
+
+		// a server with the same details is only added once
+		for (MailServerMap::const_iterator it = current->cbegin(); it != current->cend(); it++)
+		{
+			if (*it->second == server)
+				return (it->first);
+		}
+
+		FB_BIGINT serverID = nextServerID++;
+		std::shared_ptr<MailServerMap> updated = std::make_shared<MailServerMap>(*current);
+		(*updated)[serverID] = std::make_shared<const MailServer>(serverID, server);
+
+		std::atomic_store(&servers, std::shared_ptr<const MailServerMap>(updated));
+
+		return (serverID);
+	}
+
+	bool MailServerRegistry::remove(const FB_BIGINT serverID)
+	{
+		std::lock_guard<std::mutex> guard(writeLock);
+
+		std::shared_ptr<const MailServerMap> current = std::atomic_load(&servers);
+
+		if (current->find(serverID) == current->cend())
+			return (false);
+
+		// messages already queued hold their own handle to the server and
+		// are still sent after it has been removed
+		std::shared_ptr<MailServerMap> updated = std::make_shared<MailServerMap>(*current);
+		updated->erase(serverID);
+
+		std::atomic_store(&servers, std::shared_ptr<const MailServerMap>(updated));
+
+		return (true);
+	}
+
+	MailServerHandle MailServerRegistry::find(const FB_BIGINT serverID)
+	{
+		std::shared_ptr<const MailServerMap> current = std::atomic_load(&servers);
+		MailServerMap::const_iterator it = current->find(serverID);
+
+		if (it == current->cend())
+			return (nullptr);
+
+		return (it->second);
+	}
+}
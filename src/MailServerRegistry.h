@@ -0,0 +1,73 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+* MIT License
+*
+* Copyright (c) 2017 Simon Carter (s1cart3r@gmail.com)
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*
+* The Original Code was created by Simon Carter (s1cart3r@gmail.com).
+*
+* Module:  fbSMTPUDF - Firebird UDF Library for sending emails.
+*
+* Description: Registered mail servers, read without locking through an
+*			   immutable snapshot which is replaced whenever a server is added or removed.
+*
+* Date: 17/10/2026
+*
+*/
+
+
+#ifndef FB_SMTP__MAIL_SERVER_REGISTRY
+#define FB_SMTP__MAIL_SERVER_REGISTRY
+
+#include <mutex>
+#include <atomic>
+#include <memory>
+#include <unordered_map>
+
+#include "Global.h"
+#include "MailServer.h"
+
+namespace FBMailUDF
+{
+	class MailServerRegistry
+	{
+	private:
+		typedef std::unordered_map<FB_BIGINT, MailServerHandle> MailServerMap;
+
+		// readers take a reference to the current snapshot, writers copy it, make
+		// their change and publish the copy, a snapshot is never changed once published
+		std::shared_ptr<const MailServerMap> servers;
+		std::mutex writeLock;
+		std::atomic<FB_BIGINT> nextServerID;
+
+		// prevent class copying
+		MailServerRegistry(const MailServerRegistry&);
+		MailServerRegistry& operator=(const MailServerRegistry&);
+	public:
+		MailServerRegistry();
+		~MailServerRegistry();
+
+		FB_BIGINT add(const MailServer &server);
+		bool remove(const FB_BIGINT serverID);
+		MailServerHandle find(const FB_BIGINT serverID);
+	};
+}
+
+#endif
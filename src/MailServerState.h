@@ -0,0 +1,83 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+* MIT License
+*
+* Copyright (c) 2017 Simon Carter (s1cart3r@gmail.com)
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*
+* The Original Code was created by Simon Carter (s1cart3r@gmail.com).
+*
+* Module:  fbSMTPUDF - Firebird UDF Library for sending emails.
+*
+* Description: Run time state shared by every copy of a mail server,
+*			   such as the number of open send sessions.
+*
+* Date: 17/10/2026
+*
+*/
+
+
+#ifndef FB_SMTP__MAIL_SERVER_STATE
+#define FB_SMTP__MAIL_SERVER_STATE
+
+#include <atomic>
+
+#include "Global.h"
+#include "ServerRateLimit.h"
+#include "CircuitBreaker.h"
+#include "AdaptiveConcurrency.h"
+
+namespace FBMailUDF
+{
+	class QueuePartition;
+
+	class MailServerState
+	{
+	private:
+		std::atomic<int> activeSessions;
+		std::atomic<QueuePartition*> partition;
+		ServerRateLimit rateLimit;
+		CircuitBreaker breaker;
+		AdaptiveConcurrency concurrency;
+
+		// prevent class copying, state is shared via shared_ptr
+		MailServerState(const MailServerState&);
+		MailServerState& operator=(const MailServerState&);
+	public:
+		MailServerState();
+		~MailServerState();
+
+		bool tryAcquireSession();
+		void releaseSession();
+
+		int getActiveSessions();
+		int getMaxSessions();
+		int getSessionLimit();
+		EMailResult setMaxSessions(const int value);
+
+		QueuePartition* getPartition();
+		void setPartition(QueuePartition *value);
+
+		ServerRateLimit& getRateLimit();
+		CircuitBreaker& getBreaker();
+		AdaptiveConcurrency& getConcurrency();
+	};
+}
+
+#endif
@@ -37,9 +37,26 @@
 
 namespace ManagedThreads
 {
-	ThreadList globalThreadList = ThreadList();
-	std::mutex globalListLock;
-	std::mutex globalListenerLock;
+	// the thread list and its locks are created on first use and never destroyed, a
+	// detached thread that is still finishing when the library is unloaded removes
+	// itself from the list after static objects have been destroyed
+	static ThreadList& globalThreadList()
+	{
+		static ThreadList *Result = new ThreadList();
+		return (*Result);
+	}
+
+	static std::mutex& globalListLock()
+	{
+		static std::mutex *Result = new std::mutex();
+		return (*Result);
+	}
+
+	static std::mutex& globalListenerLock()
+	{
+		static std::mutex *Result = new std::mutex();
+		return (*Result);
+	}
 
 	ManagedThread::ManagedThread()
 	{
@@ -47,15 +64,19 @@ namespace ManagedThreads
 		managedID = ++uniqueID;
 		isCancelled = false;
 		runInterval = std::chrono::milliseconds(1000);
+		nextRunInterval = runInterval;
 		delayStart = 500;
 		currentThread = nullptr;
 		automaticallyDelete = false;
+		wakeRequested = false;
+		running = false;
 	}
 
 	ManagedThread::ManagedThread(const uInt interval, const uInt startDelay, const bool autoDelete)
 		: ManagedThread()
 	{
 		runInterval = std::chrono::milliseconds(interval);
+		nextRunInterval = runInterval;
 		delayStart = startDelay;
 		automaticallyDelete = autoDelete;
 	}
@@ -70,6 +91,20 @@ namespace ManagedThreads
 
 	ManagedThread::~ManagedThread()
 	{
+		// a terminated thread stops without removing itself from the global list
+		{
+			std::lock_guard<std::mutex> guard(globalListLock());
+
+			for (size_t i = 0; i < globalThreadList().size(); i++)
+			{
+				if (globalThreadList().at(i) == this)
+				{
+					globalThreadList().erase(globalThreadList().begin() + i);
+					break;
+				}
+			}
+		}
+
 		if (currentThread != nullptr && automaticallyDelete)
 		{
 			delete currentThread;
@@ -80,41 +115,41 @@ namespace ManagedThreads
 	// static methods
 	Size ManagedThread::activeThreadCount()
 	{
-		std::lock_guard<std::mutex> guard(globalListLock);
-		return (globalThreadList.size());
+		std::lock_guard<std::mutex> guard(globalListLock());
+		return (globalThreadList().size());
 	}
 
 	ManagedThread* ManagedThread::activeThreadAt(const int index)
 	{
-		std::lock_guard<std::mutex> guard(globalListLock);
-		return (globalThreadList.at(index));
+		std::lock_guard<std::mutex> guard(globalListLock());
+		return (globalThreadList().at(index));
 	}
 
 	ManagedThread* ManagedThread::getActiveThread(const std::string &threadName)
 	{
-		std::lock_guard<std::mutex> guard(globalListLock);
+		std::lock_guard<std::mutex> guard(globalListLock());
 
-		for (size_t i = 0; i < globalThreadList.size(); i++)
-			if (globalThreadList.at(i)->getName().compare(threadName) == 0)
-				return (globalThreadList.at(i));
+		for (size_t i = 0; i < globalThreadList().size(); i++)
+			if (globalThreadList().at(i)->getName().compare(threadName) == 0)
+				return (globalThreadList().at(i));
 
 		return (nullptr);
 	}
 
 	bool ManagedThread::cancel(const std::string &threadName, bool removeListeners)
 	{
-		std::lock_guard<std::mutex> guard(globalListLock);
+		std::lock_guard<std::mutex> guard(globalListLock());
 
-		for (size_t i = 0; i < globalThreadList.size(); i++)
+		for (size_t i = 0; i < globalThreadList().size(); i++)
 		{
-			if (globalThreadList.at(i)->getName().compare(threadName) == 0)
+			if (globalThreadList().at(i)->getName().compare(threadName) == 0)
 			{
-				globalThreadList.at(i)->cancel();
+				globalThreadList().at(i)->cancel();
 
 				if (removeListeners)
 				{
-					std::lock_guard<std::mutex> guard(globalListenerLock);
-					globalThreadList.at(i)->listeners.clear();
+					std::lock_guard<std::mutex> guard(globalListenerLock());
+					globalThreadList().at(i)->listeners.clear();
 				}
 
 				return (true);
@@ -126,10 +161,10 @@ namespace ManagedThreads
 
 	void ManagedThread::cancelAll()
 	{
-		std::lock_guard<std::mutex> guard(globalListLock);
+		std::lock_guard<std::mutex> guard(globalListLock());
 
-		for (size_t i = 0; i < globalThreadList.size(); i++)
-			globalThreadList.at(i)->cancel();
+		for (size_t i = 0; i < globalThreadList().size(); i++)
+			globalThreadList().at(i)->cancel();
 	}
 
 	void ManagedThread::terminateAll(uInt timeout)
@@ -153,10 +188,10 @@ namespace ManagedThreads
 		}
 
 		// if any of the threads remain active, call their terminate method
-		std::lock_guard<std::mutex> guard(globalListLock);
+		std::lock_guard<std::mutex> guard(globalListLock());
 
-		for (size_t i = 0; i < globalThreadList.size(); i++)
-			globalThreadList.at(i)->terminate();
+		for (size_t i = 0; i < globalThreadList().size(); i++)
+			globalThreadList().at(i)->terminate();
 	}
 
 	bool ManagedThread::exists(const std::string &name)
@@ -164,11 +199,11 @@ namespace ManagedThreads
 		if (name.size() == 0)
 			return (false);
 
-		std::lock_guard<std::mutex> guard(globalListLock);
+		std::lock_guard<std::mutex> guard(globalListLock());
 
-		for (size_t i = 0; i < globalThreadList.size(); i++)
+		for (size_t i = 0; i < globalThreadList().size(); i++)
 		{
-			if (globalThreadList.at(i)->name == name && !globalThreadList.at(i)->getIsCancelled())
+			if (globalThreadList().at(i)->name == name && !globalThreadList().at(i)->getIsCancelled())
 				return (true);
 		}
 
@@ -177,13 +212,13 @@ namespace ManagedThreads
 
 	void ManagedThread::addListener(ThreadNotification *listener)
 	{
-		std::lock_guard<std::mutex> guard(globalListenerLock);
+		std::lock_guard<std::mutex> guard(globalListenerLock());
 		listeners.push_back(listener);
 	}
 
 	void ManagedThread::removeListener(ThreadNotification *listener)
 	{
-		std::lock_guard<std::mutex> guard(globalListenerLock);
+		std::lock_guard<std::mutex> guard(globalListenerLock());
 
 		if (listeners.size() == 0)
 			return;
@@ -200,7 +235,7 @@ namespace ManagedThreads
 
 	void ManagedThread::notifyListeners(const EventType &type, ManagedThread *thread, const std::string &error)
 	{
-		std::lock_guard<std::mutex> guard(globalListenerLock);
+		std::lock_guard<std::mutex> guard(globalListenerLock());
 
 		for (size_t i = 0; i < listeners.size(); i++)
 		{
@@ -229,13 +264,8 @@ namespace ManagedThreads
 
 				// need to ensure that if the thread is cancelled prior to the thread being
 				// run then we provide a mechanism for the thread to close
-				while (continueTime > system_clock::now())
-				{
-					std::this_thread::sleep_for(milliseconds(100));
-
-					if (isCancelled)
-						break;
-				}
+				std::unique_lock<std::mutex> lock(wakeLock);
+				wakeEvent.wait_until(lock, continueTime, [this] { return (isCancelled || isTerminated); });
 			}
 
 			time_point<system_clock> lastRun = system_clock::now();
@@ -251,7 +281,10 @@ namespace ManagedThreads
 				{
 					// are we terminating?
 					if (isTerminated)
+					{
+						running = false;
 						return;
+					}
 
 					//have we been asked to cancel the thread?
 					if (isCancelled)
@@ -261,18 +294,36 @@ namespace ManagedThreads
 					}
 
 					duration<system_clock::rep, system_clock::period> timeSinceLastRun = system_clock::now() - lastRun;
-					
+					bool runNow = timeSinceLastRun > nextRunInterval;
+
+					{
+						std::lock_guard<std::mutex> guard(wakeLock);
+
+						if (wakeRequested)
+						{
+							wakeRequested = false;
+							runNow = true;
+						}
+					}
+
 					// run the thread
-					if (timeSinceLastRun > runInterval)
+					if (runNow)
 					{
+						// run() can ask to be run again sooner than the interval
+						nextRunInterval = runInterval;
+
 						if (!run())
 							break;
 
 						lastRun = system_clock::now();
+						continue;
 					}
 
-					// play niceley with everyone else
-					std::this_thread::sleep_for(milliseconds(100));
+					// sleep until the next run is due, the interval is only a fallback as 
+					// wake() runs the thread straight away and cancel() ends the wait
+					std::unique_lock<std::mutex> lock(wakeLock);
+					wakeEvent.wait_until(lock, lastRun + nextRunInterval, 
+						[this] { return (wakeRequested || isCancelled || isTerminated); });
 				}
 				catch (const std::exception &error)
 				{
@@ -289,25 +340,35 @@ namespace ManagedThreads
 		}
 
 		if (isTerminated)
+		{
+			running = false;
 			return;
+		}
 
 		notifyListeners(EventType::Stop, this);
 
-		// remove ourself from the global list
-		std::lock_guard<std::mutex> guard(globalListLock);
+		bool deleteThread = false;
 
-		for (size_t i = 0; i < globalThreadList.size(); i++)
+		// remove ourself from the global list
 		{
-			if (globalThreadList.at(i) == this)
-			{
-				globalThreadList.erase(globalThreadList.begin() + i);
-
-				if (automaticallyDelete && isDetached && !isJoined)
-					delete this;
+			std::lock_guard<std::mutex> guard(globalListLock());
 
-				break;
+			for (size_t i = 0; i < globalThreadList().size(); i++)
+			{
+				if (globalThreadList().at(i) == this)
+				{
+					globalThreadList().erase(globalThreadList().begin() + i);
+					deleteThread = automaticallyDelete && isDetached && !isJoined;
+					break;
+				}
 			}
 		}
+
+		// once running is cleared the owner may delete the thread, it is not used after this
+		if (deleteThread)
+			delete this;
+		else
+			running = false;
 	}
 
 	// public methods
@@ -324,7 +385,19 @@ namespace ManagedThreads
 
 	void ManagedThread::setIsTerminated(bool value)
 	{
-		isTerminated = value;
+		{
+			std::lock_guard<std::mutex> guard(wakeLock);
+			isTerminated = value;
+		}
+
+		wakeEvent.notify_all();
+	}
+
+	void ManagedThread::runAfter(const std::chrono::milliseconds &delay)
+	{
+		// only called from run(), the next run is never later than the interval
+		if (delay < nextRunInterval)
+			nextRunInterval = delay < std::chrono::milliseconds(0) ? std::chrono::milliseconds(0) : delay;
 	}
 
 	time_t ManagedThread::getTimeStarted()
@@ -353,12 +426,32 @@ namespace ManagedThreads
 
 	void ManagedThread::start(const ThreadPriority &priority, bool autoDetach)
 	{
+		// only one thread can run at a time, if two callers start the thread
+		// together the second does nothing
+		bool expected = false;
+
+		if (!running.compare_exchange_strong(expected, true))
+			return;
+
+		// a thread being started again has finished running, the previous thread is
+		// released before it is replaced and is joined first if it was not detached
+		if (currentThread != nullptr)
+		{
+			if (currentThread->joinable())
+				currentThread->join();
+
+			delete currentThread;
+			currentThread = nullptr;
+		}
+
 		isCancelled = false;
 		isTerminated = false;
+		isDetached = false;
+		isJoined = false;
 		currentThread = new std::thread(&ManagedThread::runThread, this);
 		SetThreadPriority(currentThread->native_handle(), static_cast<int>(priority));
-		std::lock_guard<std::mutex> guard(globalListLock);
-		globalThreadList.push_back(this);
+		std::lock_guard<std::mutex> guard(globalListLock());
+		globalThreadList().push_back(this);
 
 		if (autoDetach)
 		{
@@ -369,7 +462,7 @@ namespace ManagedThreads
 
 	bool ManagedThread::isRunning()
 	{
-		return (currentThread != nullptr);
+		return (running);
 	}
 
 	// methods
@@ -378,8 +471,23 @@ namespace ManagedThreads
 		if (!currentThread)
 			return;
 
-		isCancelled = true;
+		{
+			std::lock_guard<std::mutex> guard(wakeLock);
+			isCancelled = true;
+		}
+
 		time(&cancelledTime);
+		wakeEvent.notify_all();
+	}
+
+	void ManagedThread::wake()
+	{
+		{
+			std::lock_guard<std::mutex> guard(wakeLock);
+			wakeRequested = true;
+		}
+
+		wakeEvent.notify_all();
 	}
 
 	void ManagedThread::join()
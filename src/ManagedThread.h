@@ -42,6 +42,9 @@
 #include <winnt.h>
 #include <thread>
 #include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <chrono>
 #include <vector>
 
 namespace ManagedThreads
@@ -94,7 +97,12 @@ namespace ManagedThreads
 		uInt delayStart;
 		uInt managedID;
 		std::chrono::milliseconds runInterval;
+		std::chrono::milliseconds nextRunInterval;
 		std::string name;
+		std::mutex wakeLock;
+		std::condition_variable wakeEvent;
+		bool wakeRequested;
+		std::atomic<bool> running;
 
 		void runThread();
 
@@ -107,12 +115,13 @@ namespace ManagedThreads
 		NotificationList listeners;
 		virtual bool run() = 0;
 		void setIsTerminated(bool value);
+		void runAfter(const std::chrono::milliseconds &delay);
 	public:
 		ManagedThread();
 		ManagedThread(const uInt interval, const uInt startDelay, bool autoDelete);
 		ManagedThread(const std::string &name, const uInt interval, const uInt startDelay, 
 			const bool runImmediately, const bool autoDelete);
-		~ManagedThread();
+		virtual ~ManagedThread();
 
 		// operator overloads for comparisons
 		bool operator ==(const ManagedThread& val) const { return (managedID == val.managedID); }
@@ -123,6 +132,7 @@ namespace ManagedThreads
 		// virtual methods
 		virtual void terminate() = 0;
 		virtual void cancel();
+		virtual void wake();
 
 		//static methods
 		static Size activeThreadCount();
@@ -0,0 +1,228 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+* MIT License
+*
+* Copyright (c) 2017 Simon Carter (s1cart3r@gmail.com)
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*
+* The Original Code was created by Simon Carter (s1cart3r@gmail.com).
+*
+* Module:  fbSMTPUDF - Firebird UDF Library for sending emails.
+*
+* Description: Queue of messages waiting to be sent, ordered by priority
+*			   and then by deadline, earliest first.
+*
+* Date: 17/10/2026
+*
+*/
+
+
+#include <limits>
+
+#include "MessageQueue.h"
+
+namespace FBMailUDF
+{
+	bool MessageQueue::QueueKey::operator <(const QueueKey &value) const
+	{
+		if (lane != value.lane)
+			return (lane < value.lane);
+
+		if (deadline != value.deadline)
+			return (deadline < value.deadline);
+
+		return (sequence < value.sequence);
+	}
+
+	MessageQueue::MessageQueue()
+		: nextSequence(0)
+	{
+
+	}
+
+	MessageQueue::~MessageQueue()
+	{
+
+	}
+
+	MessageQueue::QueueKey MessageQueue::getKey(MailMessage &message)
+	{
+		QueueKey Result;
+		Result.lane = getLane(message.getPriority());
+
+		// messages without a deadline are sent after those with one
+		Result.deadline = message.getDeadline() > 0 ? message.getDeadline() : std::numeric_limits<time_t>::max();
+		Result.sequence = message.getSequence();
+
+		return (Result);
+	}
+
+	int MessageQueue::getLane(const CSmptXPriority priority)
+	{
+		switch (priority)
+		{
+			case CSmptXPriority::XPRIORITY_HIGH:
+				return (0);
+			case CSmptXPriority::XPRIORITY_LOW:
+				return (2);
+			default:
+				return (1);
+		}
+	}
+
+	void MessageQueue::push(MailMessage &&message)
+	{
+		// a message returned to the queue keeps its original sequence so it 
+		// goes back to the position it was claimed from
+		if (message.getSequence() == 0)
+			message.setSequence(++nextSequence);
+
+		MailServerHandle server = message.getMailServer();
+		QueueKey key = getKey(message);
+
+		messages.emplace(key, std::move(message));
+		serverQueues[server->getState().get()].insert(key);
+	}
+
+	bool MessageQueue::claimBatch(MailServerHandle &server, MailMessageList &batch, const size_t maxMessages,
+		std::chrono::steady_clock::time_point &available)
+	{
+		// servers which have reached their rate limit or daily quota, or can not be reached, 
+		// are skipped, available is set to the earliest time one of them can send again
+		std::set<MailServerState*> limited;
+		std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+		std::chrono::milliseconds window = RecipientGrouping::getWindow();
+
+		// the first message of each server is compared rather than every message, so 
+		// servers already sending on all of their allowed sessions are skipped without
+		// walking through the messages waiting for them
+		while (true)
+		{
+			ServerQueueMap::iterator next = serverQueues.end();
+
+			for (ServerQueueMap::iterator it = serverQueues.begin(); it != serverQueues.end(); it++)
+			{
+				if (it->first->getActiveSessions() >= it->first->getSessionLimit())
+					continue;
+
+				if (limited.find(it->first) != limited.end())
+					continue;
+
+				// a server with only a few messages waits for the group window so more 
+				// can be sent over the same session, high priority messages and those 
+				// with a deadline do not wait
+				const QueueKey &head = *it->second.begin();
+
+				if (window.count() > 0 && it->second.size() < maxMessages && head.lane != 0 && 
+					head.deadline == std::numeric_limits<time_t>::max())
+				{
+					std::chrono::steady_clock::time_point groupTime = 
+						messages.find(head)->second.getQueuedTime() + window;
+
+					if (groupTime > now)
+					{
+						if (groupTime < available)
+							available = groupTime;
+
+						continue;
+					}
+				}
+
+				if (next == serverQueues.end() || *it->second.begin() < *next->second.begin())
+					next = it;
+			}
+
+			if (next == serverQueues.end())
+				return (false);
+
+			// another thread may have taken the last free session since it was checked
+			if (!next->first->tryAcquireSession())
+				continue;
+
+			std::chrono::steady_clock::time_point nextSend;
+			bool probe = false;
+
+			// a server which can not be reached is skipped until it is due to be probed
+			if (!next->first->getBreaker().allowRequest(probe, nextSend))
+			{
+				next->first->releaseSession();
+				limited.insert(next->first);
+
+				if (nextSend < available)
+					available = nextSend;
+
+				continue;
+			}
+
+			// a probe is a single message, so a dead server fails one message not a batch
+			std::set<QueueKey> &keys = next->second;
+			size_t requested = probe ? 1 : (keys.size() < maxMessages ? keys.size() : maxMessages);
+			size_t allowed = next->first->getRateLimit().tryAcquire(static_cast<int>(requested), nextSend);
+
+			if (allowed == 0)
+			{
+				if (probe)
+					next->first->getBreaker().probeCancelled();
+
+				next->first->releaseSession();
+				limited.insert(next->first);
+
+				if (nextSend < available)
+					available = nextSend;
+
+				continue;
+			}
+
+			// the messages for the server are sent together over a single session, 
+			// highest priority and earliest deadline first
+			server = messages.find(*keys.begin())->second.getMailServer();
+
+			while (!keys.empty() && batch.size() < allowed)
+			{
+				MessageMap::iterator message = messages.find(*keys.begin());
+
+				batch.push_back(std::move(message->second));
+				messages.erase(message);
+				keys.erase(keys.begin());
+			}
+
+			if (keys.empty())
+				serverQueues.erase(next);
+
+			return (true);
+		}
+	}
+
+	size_t MessageQueue::size()
+	{
+		return (messages.size());
+	}
+
+	void MessageQueue::clear()
+	{
+		messages.clear();
+		serverQueues.clear();
+	}
+
+	void MessageQueue::swap(MessageQueue &value)
+	{
+		messages.swap(value.messages);
+		serverQueues.swap(value.serverQueues);
+	}
+}
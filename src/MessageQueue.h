@@ -0,0 +1,89 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+* MIT License
+*
+* Copyright (c) 2017 Simon Carter (s1cart3r@gmail.com)
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*
+* The Original Code was created by Simon Carter (s1cart3r@gmail.com).
+*
+* Module:  fbSMTPUDF - Firebird UDF Library for sending emails.
+*
+* Description: Queue of messages waiting to be sent, ordered by priority
+*			   and then by deadline, earliest first.
+*
+* Date: 17/10/2026
+*
+*/
+
+
+#ifndef FB_SMTP__MESSAGE_QUEUE
+#define FB_SMTP__MESSAGE_QUEUE
+
+#include <map>
+#include <set>
+#include <chrono>
+
+#include "Global.h"
+#include "MailMessage.h"
+#include "MailServer.h"
+#include "RecipientGrouping.h"
+
+namespace FBMailUDF
+{
+	// messages are held in high, normal and low priority lanes, within a lane messages with
+	// a deadline are sent earliest deadline first, followed by messages without a deadline 
+	// in the order they were queued.  The queue is not thread safe, callers must lock it.
+	class MessageQueue
+	{
+	private:
+		struct QueueKey
+		{
+			int lane;
+			time_t deadline;
+			uint64_t sequence;
+
+			bool operator <(const QueueKey &value) const;
+		};
+
+		typedef std::map<QueueKey, MailMessage> MessageMap;
+		typedef std::map<MailServerState*, std::set<QueueKey>> ServerQueueMap;
+
+		MessageMap messages;
+		ServerQueueMap serverQueues;
+		uint64_t nextSequence;
+
+		QueueKey getKey(MailMessage &message);
+	public:
+		MessageQueue();
+		~MessageQueue();
+
+		void push(MailMessage &&message);
+		bool claimBatch(MailServerHandle &server, MailMessageList &batch, const size_t maxMessages,
+			std::chrono::steady_clock::time_point &available);
+
+		static int getLane(const CSmptXPriority priority);
+
+		size_t size();
+		void clear();
+		void swap(MessageQueue &value);
+	};
+}
+
+#endif
@@ -36,14 +36,48 @@
 
 namespace FBMailUDF
 {
-	std::mutex listenerLock;
-	std::mutex sendListLockMutex;
-	std::mutex queueLockMutex;
-	MailMessageList messagesToSend;
-	MailMessageList messageQueue;
+	typedef std::map<std::string, std::unique_ptr<QueuePartition>> QueuePartitionMap;
 
-	MessageSendThread::MessageSendThread()
-		: ManagedThread(SMTP_THREAD_NAME, THREAD_RUN_INTERVAL_SECONDS, 0, true, false)
+	std::atomic<size_t> nextPartition(0);
+
+	// the state shared by the send threads is created on first use and never destroyed, 
+	// a send thread still finishing a message when the library is unloaded can use it
+	// after static objects have been destroyed
+	static std::mutex& listenerLock()
+	{
+		static std::mutex *Result = new std::mutex();
+		return (*Result);
+	}
+
+	static std::mutex& partitionListLockMutex()
+	{
+		static std::mutex *Result = new std::mutex();
+		return (*Result);
+	}
+
+	// each database has its own queue partition, partitions are created the first time 
+	// a database queues a message or sets its weight and are never removed
+	static QueuePartitionMap& partitionMap()
+	{
+		static QueuePartitionMap *Result = new QueuePartitionMap();
+		return (*Result);
+	}
+
+	static std::vector<QueuePartition*>& partitionList()
+	{
+		static std::vector<QueuePartition*> *Result = new std::vector<QueuePartition*>();
+		return (*Result);
+	}
+
+	// sessions are shared by all of the send threads
+	static SmtpConnectionPool& connectionPool()
+	{
+		static SmtpConnectionPool *Result = new SmtpConnectionPool();
+		return (*Result);
+	}
+
+	MessageSendThread::MessageSendThread(const std::string &threadName)
+		: ManagedThread(threadName, THREAD_RUN_INTERVAL_SECONDS, 0, true, false), sending(false)
 	{
 	}
 
@@ -58,126 +92,367 @@ namespace FBMailUDF
 
 	bool MessageSendThread::run()
 	{
-		std::lock_guard<std::mutex> guard(sendListLockMutex);
+		MailServerHandle server;
+		MailMessageList batch;
+		QueuePartition *partition = nullptr;
+		std::chrono::steady_clock::time_point available = std::chrono::steady_clock::time_point::max();
+
+		sending = true;
 
-		while (messagesToSend.size() > 0)
+		// a partition is only locked whilst a batch is claimed, other send threads 
+		// claim batches for other servers whilst this one is sending
+		while (!getIsCancelled() && claimBatch(server, batch, partition, available))
 		{
-			// check to see if cancelled
-			if (getIsCancelled())
-				return (false);
+			size_t sent = sendBatch(server, batch, *partition);
 
-			MailMessage message = messagesToSend.front();
+			server->getState()->releaseSession();
 
-			MailSendResult result = MailSendResult(message.getMessageID(), 
-				message.getMailServer().getServerID(), EMailResult::NotSent);
-			try
-			{
-				CSmtp mail;
+			// anything not sent because the thread was cancelled goes back to the front
+			// and does not count towards the rate limit of the server
+			server->getState()->getRateLimit().refund(static_cast<int>(batch.size() - sent));
+			partition->returnUnsent(batch, sent);
+			batch.clear();
+		}
 
-				mail.SetSMTPServer(message.getMailServer().getServerName().c_str(), 
-					message.getMailServer().getPortNumber());
-				mail.SetSecurityType(message.getMailServer().getSecurityType());
-				mail.SetLogin(message.getMailServer().getUserName().c_str());
-				mail.SetPassword(message.getMailServer().getUserPassword().c_str());
-				mail.SetXMailer(message.getMailServer().getXMailer().c_str());
-				mail.SetXPriority(message.getPriority());
+		sending = false;
 
-				mail.SetSenderName(message.getSenderName().c_str());
-				mail.SetSenderMail(message.getSenderEmail().c_str());
-				mail.SetReplyTo(message.getSenderEmail().c_str());
+		// messages held back by a rate limit are sent as soon as the server allows, 
+		// rather than when the thread is next woken
+		if (available != std::chrono::steady_clock::time_point::max())
+			runAfter(std::chrono::duration_cast<std::chrono::milliseconds>(
+				available - std::chrono::steady_clock::now()));
 
-				mail.SetSubject(message.getSubject().c_str());
-				mail.AddRecipient(message.getRecipientEmail().c_str(), message.getRecipientName().c_str());
+		// close any pooled sessions which have not been used recently
+		connectionPool().evictIdle();
 
-				std::istringstream f(message.getMessage());
-				std::string line;
+		// the thread stays running and waits to be woken when a message is queued
+		return (!getIsCancelled());
+	}
 
-				while (std::getline(f, line))
-				{
-					mail.AddMsgLine(line.c_str());
-				}
+	// private methods
+
+	void MessageSendThread::prepareMessage(CSmtp &mail, MailMessage &message)
+	{
+		mail.SetXMailer(message.getMailServer()->getXMailer().c_str());
+		mail.SetXPriority(message.getPriority());
+
+		// message fields are null terminated within the message buffer
+		mail.SetSenderName(message.getSenderName().data());
+		mail.SetSenderMail(message.getSenderEmail().data());
+		mail.SetReplyTo(message.getSenderEmail().data());
+
+		mail.SetSubject(message.getSubject().data());
+		mail.AddRecipient(message.getRecipientEmail().data(), message.getRecipientName().data());
+
+		// the body is converted in to the bytes sent after DATA in a single pass and 
+		// moved in to the session, it is not copied again
+		std::string wireBody;
+		std::string_view body = message.getMessage();
+
+		BodyNormaliser::normalise(body.data(), body.size(), wireBody);
+		mail.SetMsgBody(std::move(wireBody));
+	}
+
+	MailSendResult MessageSendThread::sendOnSession(CSmtp &mail, MailMessage *messages, const size_t count, bool &transient)
+	{
+		MailMessage &message = messages[0];
+		transient = false;
+
+		MailSendResult result = MailSendResult(message.getMessageID(), 
+			message.getMailServer()->getServerID(), EMailResult::NotSent);
+		MailServerState *state = message.getMailServer()->getState().get();
 
-				mail.Send();
-				result.setSendResult(EMailResult::Success);
+		try
+		{
+			mail.ClearMessage();
+			prepareMessage(mail, message);
+
+			// recipients sharing a transaction are not shown each others address
+			if (count > 1)
+			{
+				mail.DelRecipients();
+
+				for (size_t i = 0; i < count; i++)
+					mail.AddBCCRecipient(messages[i].getRecipientEmail().data(), messages[i].getRecipientName().data());
 			}
-			catch (const ECSmtp &e)
+
+			// if the session is not connected, Send connects to the server first
+			mail.Send();
+			result.setSendResult(EMailResult::Success);
+			state->getBreaker().recordSuccess();
+
+			// the reply time to MAIL FROM shows how busy the server is, the time taken 
+			// by Send also depends on the size of the message and any attachments
+			state->getConcurrency().recordSuccess(std::chrono::microseconds(mail.GetReplyLatency()));
+		}
+		catch (const ECSmtp &e)
+		{
+			result.setErrorCode(e.GetErrorNum());
+			result.setErrorMessage(e.GetErrorText().c_str());
+			transient = RetryPolicy::isTransient(e);
+
+			if (CircuitBreaker::isConnectionFailure(e))
+				state->getBreaker().recordFailure();
+			else
+				state->getBreaker().recordSuccess();
+
+			// the server is asking for fewer messages, fewer sessions are used for it
+			if (AdaptiveConcurrency::isThrottleReply(e.GetReplyCode()))
+				state->getConcurrency().recordThrottled();
+		}
+		catch (const std::exception &e)
+		{
+			result.setErrorMessage(e.what());
+			state->getBreaker().probeCancelled();
+
+			// the state of the session is unknown, it can not be reused
+			mail.DisconnectRemoteServer();
+		}
+
+		return (result);
+	}
+
+	size_t MessageSendThread::sendBatch(const MailServerHandle &server, MailMessageList &batch, QueuePartition &partition)
+	{
+		CSmtp *mail = nullptr;
+		size_t Result = 0;
+
+		try
+		{
+			mail = connectionPool().acquire(server);
+		}
+		catch (const ECSmtp &e)
+		{
+			recordSessionFailure(server, e);
+
+			// without a session none of the messages can be sent, the database is not
+			// charged for them although each has a result or is retried
+			partition.refundDeficit(static_cast<int>(batch.size()));
+
+			for (; Result < batch.size(); Result++)
 			{
+				MailSendResult result = MailSendResult(batch.at(Result).getMessageID(), 
+					server->getServerID(), EMailResult::NotSent);
 				result.setErrorCode(e.GetErrorNum());
 				result.setErrorMessage(e.GetErrorText().c_str());
+				completeMessage(batch.at(Result), result, RetryPolicy::isTransient(e), partition);
 			}
-			catch (const std::exception &e)
+
+			return (Result);
+		}
+
+		// within a priority and deadline, messages for the same domain are sent one after another
+		RecipientGrouping::sortByDomain(batch, 0);
+
+		while (Result < batch.size())
+		{
+			if (getIsCancelled())
+				break;
+
+			// once the server can not be reached the rest of the batch is returned to 
+			// the queue rather than each message waiting for the connection to time out
+			if (Result > 0 && !server->getState()->getBreaker().isClosed())
+				break;
+
+			// RSET between transactions, if the reset fails the session is closed 
+			// and the next send reconnects
+			if (Result > 0 && mail->IsConnected())
 			{
-				result.setErrorMessage(e.what());
+				try
+				{
+					mail->Reset();
+				}
+				catch (const ECSmtp &){}
 			}
 
-			notifyMailListeners(result);
-			messagesToSend.erase(messagesToSend.cbegin());
-
-			std::this_thread::sleep_for(chrono::milliseconds(MAIL_SEND_DELAY));
+			size_t count = RecipientGrouping::groupSize(batch, Result);
+			sendGroup(*mail, batch, Result, count, partition);
+			Result += count;
 		}
 
+		connectionPool().release(server, mail);
+
+		return (Result);
+	}
+
+	void MessageSendThread::sendGroup(CSmtp &mail, MailMessageList &batch, const size_t first, const size_t count, 
+		QueuePartition &partition)
+	{
+		bool transient = false;
+		MailSendResult result = sendOnSession(mail, batch.data() + first, count, transient);
+
+		for (size_t i = first; i < first + count; i++)
 		{
-			// if more messages have been queud since this thread started running
-			// copy them to the primary send list now
-			std::lock_guard<std::mutex> guard(queueLockMutex);
+			MailSendResult messageResult = result;
+			messageResult.setMessageID(batch.at(i).getMessageID());
 
-			while (messageQueue.size() > 0)
+			// a recipient rejected by the server fails on its own, the message is still 
+			// sent to the other recipients of the transaction
+			if (result.getSendResult() == EMailResult::Success && isRejected(mail, batch.at(i)))
 			{
-				MailMessage message = messageQueue.front();
-				messagesToSend.push_back(message);
-				messageQueue.erase(messageQueue.cbegin());
+				messageResult.setSendResult(EMailResult::NotSent);
+				messageResult.setErrorCode(ECSmtp::COMMAND_RCPT_TO);
+				messageResult.setErrorMessage(ECSmtp(ECSmtp::COMMAND_RCPT_TO).GetErrorText());
+				completeMessage(batch.at(i), messageResult, false, partition);
+				continue;
 			}
+
+			completeMessage(batch.at(i), messageResult, transient, partition);
+		}
+	}
+
+	bool MessageSendThread::isRejected(CSmtp &mail, MailMessage &message)
+	{
+		for (unsigned int i = 0; i < mail.GetRejectedRecipientCount(); i++)
+		{
+			if (message.getRecipientEmail() == mail.GetRejectedRecipient(i))
+				return (true);
 		}
 
-		return (messagesToSend.size() > 0);
+		return (false);
 	}
 
-	// private methods
+	void MessageSendThread::recordSessionFailure(const MailServerHandle &server, const ECSmtp &error)
+	{
+		// a probe which could not get a session did not reach the server
+		if (CircuitBreaker::isConnectionFailure(error))
+			server->getState()->getBreaker().recordFailure();
+		else
+			server->getState()->getBreaker().probeCancelled();
+	}
 
-	EMailResult MessageSendThread::sendImmediate(MailMessage &message)
+	void MessageSendThread::completeMessage(MailMessage &message, const MailSendResult &result, const bool transient, 
+		QueuePartition &partition)
 	{
-		MailSendResult result = MailSendResult(message.getMessageID(),
-			message.getMailServer().getServerID(), EMailResult::NotSent);
-		try
+		if (transient)
 		{
-			CSmtp mail;
+			message.attemptFailed();
+
+			// the message is queued again as it is, only the final result is published
+			if (RetryPolicy::canRetry(message.getAttempts()))
+			{
+				time_t retryTime = RetryPolicy::nextAttempt(message.getAttempts());
+				partition.retryMessage(std::move(message), retryTime);
+				return;
+			}
+		}
 
-			mail.SetSMTPServer(message.getMailServer().getServerName().c_str(),
-				message.getMailServer().getPortNumber());
-			mail.SetSecurityType(message.getMailServer().getSecurityType());
-			mail.SetLogin(message.getMailServer().getUserName().c_str());
-			mail.SetPassword(message.getMailServer().getUserPassword().c_str());
-			mail.SetXMailer(message.getMailServer().getXMailer().c_str());
-			mail.SetXPriority(message.getPriority());
+		notifyMailListeners(result);
+		partition.messageCompleted();
+	}
 
-			mail.SetSenderName(message.getSenderName().c_str());
-			mail.SetSenderMail(message.getSenderEmail().c_str());
-			mail.SetReplyTo(message.getSenderEmail().c_str());
+	bool MessageSendThread::claimBatch(MailServerHandle &server, MailMessageList &batch, QueuePartition *&partition,
+		std::chrono::steady_clock::time_point &available)
+	{
+		std::vector<QueuePartition*> partitions;
 
-			mail.SetSubject(message.getSubject().c_str());
-			mail.AddRecipient(message.getRecipientEmail().c_str(), message.getRecipientName().c_str());
+		{
+			std::lock_guard<std::mutex> guard(partitionListLockMutex());
+			partitions = partitionList();
+		}
 
-			std::istringstream f(message.getMessage());
-			std::string line;
+		partition = QueuePartition::claimNextBatch(partitions, nextPartition, server, batch, available);
 
-			while (std::getline(f, line))
-			{
-				mail.AddMsgLine(line.c_str());
-			}
+		return (partition != nullptr);
+	}
 
-			mail.Send();
-			result.setSendResult(EMailResult::Success);
+	QueuePartition* MessageSendThread::findPartition(const std::string &database, const bool create)
+	{
+		std::lock_guard<std::mutex> guard(partitionListLockMutex());
+
+		QueuePartitionMap::iterator it = partitionMap().find(database);
+
+		if (it != partitionMap().end())
+			return (it->second.get());
+
+		if (!create)
+			return (nullptr);
+
+		QueuePartition *Result = new QueuePartition(database);
+		partitionMap()[database].reset(Result);
+		partitionList().push_back(Result);
+
+		return (Result);
+	}
+
+	MailSendResult MessageSendThread::deliverMessage(MailMessage &message)
+	{
+		MailServerHandle server = message.getMailServer();
+		CSmtp *mail = nullptr;
+
+		try
+		{
+			// sessions are taken from the pool, if the server has an idle session it
+			// is reused, otherwise a new session is connected when sending
+			mail = connectionPool().acquire(server);
 		}
 		catch (const ECSmtp &e)
 		{
+			recordSessionFailure(server, e);
+
+			MailSendResult result = MailSendResult(message.getMessageID(), server->getServerID(), EMailResult::NotSent);
 			result.setErrorCode(e.GetErrorNum());
 			result.setErrorMessage(e.GetErrorText().c_str());
+			return (result);
 		}
-		catch (const std::exception &e)
+
+		bool transient = false;
+		MailSendResult result = sendOnSession(*mail, &message, 1, transient);
+
+		connectionPool().release(server, mail);
+
+		return (result);
+	}
+
+	EMailResult MessageSendThread::sendImmediate(MailMessage &message)
+	{
+		MailServerState *state = message.getMailServer()->getState().get();
+		std::chrono::steady_clock::time_point available;
+		bool probe = false;
+
+		// a message sent immediately uses one of the sessions of the server, if all of
+		// them are in use it is held back in the same way as a message over the rate limit
+		if (!state->tryAcquireSession())
 		{
-			result.setErrorMessage(e.what());
+			MailSendResult result = MailSendResult(message.getMessageID(), 
+				message.getMailServer()->getServerID(), EMailResult::RateLimited);
+			notifyMailListeners(result);
+
+			return (result.getSendResult());
+		}
+
+		// if the server can not be reached the message fails straight away, unless 
+		// it is due to be probed in which case this message is the probe
+		if (!state->getBreaker().allowRequest(probe, available))
+		{
+			state->releaseSession();
+
+			MailSendResult result = MailSendResult(message.getMessageID(), 
+				message.getMailServer()->getServerID(), EMailResult::ServerUnavailable);
+			notifyMailListeners(result);
+
+			return (result.getSendResult());
 		}
 
+		// messages sent immediately count towards the rate limit of the server but
+		// are not held back, if the limit has been reached the message is not sent
+		if (state->getRateLimit().tryAcquire(1, available) == 0)
+		{
+			if (probe)
+				state->getBreaker().probeCancelled();
+
+			state->releaseSession();
+
+			MailSendResult result = MailSendResult(message.getMessageID(), 
+				message.getMailServer()->getServerID(), EMailResult::RateLimited);
+			notifyMailListeners(result);
+
+			return (result.getSendResult());
+		}
+
+		MailSendResult result = deliverMessage(message);
+
+		state->releaseSession();
 		notifyMailListeners(result);
 
 		return (result.getSendResult());
@@ -185,7 +460,7 @@ namespace FBMailUDF
 
 	void MessageSendThread::notifyMailListeners(MailSendResult notification)
 	{
-		std::lock_guard<std::mutex> guard(listenerLock);
+		std::lock_guard<std::mutex> guard(listenerLock());
 
 		for (size_t i = 0; i < emailResultListeners.size(); i++)
 		{
@@ -200,63 +475,64 @@ namespace FBMailUDF
 	// public methods
 	void MessageSendThread::addMailListener(MailSendNotification *listener)
 	{
-		std::lock_guard<std::mutex> guard(listenerLock);
+		std::lock_guard<std::mutex> guard(listenerLock());
 		emailResultListeners.push_back(listener);
 	}
 
 	void MessageSendThread::removeMailListener(MailSendNotification *listener)
 	{
-		std::lock_guard<std::mutex> guard(listenerLock);
+		std::lock_guard<std::mutex> guard(listenerLock());
 
 		if (emailResultListeners.size() == 0)
 			return;
 
-		for (size_t i = 0; i < listeners.size(); i++)
+		for (size_t i = 0; i < emailResultListeners.size(); i++)
 		{
 			if (emailResultListeners.at(i) == listener)
 			{
-				listeners.erase(listeners.begin() + i);
+				emailResultListeners.erase(emailResultListeners.begin() + i);
 				break;
 			}
 		}
 	}
 
 	// static methods
-	void MessageSendThread::messageAdd(MailMessage message)
+	void MessageSendThread::messageAdd(MailMessage &&message)
 	{
-		std::lock_guard<std::mutex> guard(queueLockMutex);
-		messageQueue.push_back(message);
+		// the partition for a server is found once and then held by the server
+		MailServerState *state = message.getMailServer()->getState().get();
+		QueuePartition *partition = state->getPartition();
+
+		if (partition == nullptr)
+		{
+			partition = findPartition(message.getMailServer()->getDatabase(), true);
+			state->setPartition(partition);
+		}
+
+		partition->push(std::move(message));
 	}
 
 	int MessageSendThread::messageQueueCount(const std::string &database, const bool removeAll)
 	{
-		int Result = 0;
+		QueuePartition *partition = findPartition(database, false);
 
-		{
-			std::lock_guard<std::mutex> guard(sendListLockMutex);
-			
-			for (size_t i = messagesToSend.size(); i > 0; i--)
-			{
-				if (messagesToSend.at(i -1).getMailServer().getDatabase().compare(database) == 0)
-					Result++;
+		if (partition == nullptr)
+			return (0);
 
-				if (removeAll)
-					messagesToSend.erase(messagesToSend.cbegin() + (i -1));
-			}
-		}
+		int Result = partition->count();
 
-		std::lock_guard<std::mutex> guard(queueLockMutex);
+		if (removeAll)
+			partition->cancel();
 
-		for (size_t i = messageQueue.size(); i > 0; i--)
-		{
-			if (messageQueue.at(i -1).getMailServer().getDatabase().compare(database) == 0)
-				Result++;
+		return (Result);
+	}
 
-			if (removeAll)
-				messageQueue.erase(messageQueue.cbegin() + (i -1));
-		}
+	EMailResult MessageSendThread::setDatabaseWeight(const std::string &database, const int weight)
+	{
+		if (database.empty())
+			return (EMailResult::InvalidDatabaseName);
 
-		return (Result);
+		return (findPartition(database, true)->setWeight(weight));
 	}
 
 	void MessageSendThread::start()
@@ -269,17 +545,26 @@ namespace FBMailUDF
 		ManagedThreads::ManagedThread::cancel();
 	}
 
-	void MessageSendThread::cancelAll(const std::string &database)
+	bool MessageSendThread::isActive()
 	{
-		std::lock_guard<std::mutex> guard(sendListLockMutex);
+		return (isRunning() && !getIsCancelled());
+	}
 
-		if (messagesToSend.size() == 0)
-			return;
+	bool MessageSendThread::isSending()
+	{
+		return (sending);
+	}
 
-		for (size_t i = messagesToSend.size() - 1; i >= 0; i--)
-		{
-			if (messagesToSend.at(i).getMailServer().getDatabase().compare(database) == 0)
-				messagesToSend.erase(messagesToSend.cend() - i);
-		}
+	void MessageSendThread::wake()
+	{
+		ManagedThreads::ManagedThread::wake();
+	}
+
+	void MessageSendThread::cancelAll(const std::string &database)
+	{
+		QueuePartition *partition = findPartition(database, false);
+
+		if (partition != nullptr)
+			partition->cancel();
 	}
 }
\ No newline at end of file
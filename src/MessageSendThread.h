@@ -39,6 +39,9 @@
 #include <sstream>
 #include <iostream>
 #include <chrono>
+#include <map>
+#include <atomic>
+#include <vector>
 
 #include "Global.h"
 #include "ManagedThread.h"
@@ -46,6 +49,11 @@
 #include "MailServer.h"
 #include "MailSendResult.h"
 #include "CSmtp.h"
+#include "SmtpConnectionPool.h"
+#include "QueuePartition.h"
+#include "RetryPolicy.h"
+#include "RecipientGrouping.h"
+#include "BodyNormaliser.h"
 
 namespace FBMailUDF
 {
@@ -53,22 +61,41 @@ namespace FBMailUDF
 	{
 	private:
 		void notifyMailListeners(MailSendResult notification);
+		void prepareMessage(CSmtp &mail, MailMessage &message);
+		MailSendResult sendOnSession(CSmtp &mail, MailMessage *messages, const size_t count, bool &transient);
+		void sendGroup(CSmtp &mail, MailMessageList &batch, const size_t first, const size_t count, 
+			QueuePartition &partition);
+		bool isRejected(CSmtp &mail, MailMessage &message);
+		void recordSessionFailure(const MailServerHandle &server, const ECSmtp &error);
+		void completeMessage(MailMessage &message, const MailSendResult &result, const bool transient, 
+			QueuePartition &partition);
+		MailSendResult deliverMessage(MailMessage &message);
+		size_t sendBatch(const MailServerHandle &server, MailMessageList &batch, QueuePartition &partition);
+		bool claimBatch(MailServerHandle &server, MailMessageList &batch, QueuePartition *&partition,
+			std::chrono::steady_clock::time_point &available);
+		static QueuePartition* findPartition(const std::string &database, const bool create);
 		MailSendNotificationList emailResultListeners;
+		std::atomic<bool> sending;
 	protected:
 		bool run();
 	public:
-		MessageSendThread();
+		MessageSendThread(const std::string &threadName);
 		~MessageSendThread();
 
 		void terminate();
 
 		// static methods
-		static void messageAdd(MailMessage message);
+		static void messageAdd(MailMessage &&message);
 
 		static int messageQueueCount(const std::string &database, const bool removeAll);
+		static EMailResult setDatabaseWeight(const std::string &database, const int weight);
 
 		void start();
 		void cancel();
+		using ManagedThreads::ManagedThread::isRunning;
+		bool isActive();
+		bool isSending();
+		void wake();
 
 		void addMailListener(MailSendNotification *listener);
 		void removeMailListener(MailSendNotification *listener);
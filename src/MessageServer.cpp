@@ -36,30 +36,65 @@
 
 namespace FBMailUDF
 {
-	std::mutex serverListLockMutex;
-	std::mutex resultListLockMutex;
+	std::mutex threadListLockMutex;
 
 	MessageServer::MessageServer()
+		: sendThreadCount(0)
 	{
-		
+		// every send thread is created up front so queueing a message can wake or 
+		// start a thread without locking the list of threads
+		for (int i = 0; i < MAX_SEND_THREAD_COUNT; i++)
+		{
+			MessageSendThread *sender = new MessageSendThread(std::string(SMTP_THREAD_NAME) + " " +
+				std::to_string(i + 1));
+			sender->addMailListener(this);
+			mailThreads.push_back(sender);
+		}
+
+		setSendThreadCount(DEFAULT_SEND_THREAD_COUNT);
 	}
 
 	MessageServer::MessageServer(const MessageServer &copy)
+		: MessageServer()
 	{
 
 	}
 
 	MessageServer::~MessageServer()
 	{
-		mailThread.terminate();
+		std::lock_guard<std::mutex> guard(threadListLockMutex);
+
+		// the send threads are detached, each is asked to stop and no longer reports to
+		// the server, then given time to finish the message it is sending
+		for (size_t i = 0; i < mailThreads.size(); i++)
+		{
+			mailThreads.at(i)->removeMailListener(this);
+			mailThreads.at(i)->cancel();
+			mailThreads.at(i)->terminate();
+		}
+
+		std::chrono::steady_clock::time_point stopBy = std::chrono::steady_clock::now() + 
+			std::chrono::milliseconds(SEND_THREAD_STOP_TIMEOUT);
+
+		// a thread is only deleted once it has stopped, a thread still waiting on the
+		// server when the time is up is left rather than deleted whilst it is running,
+		// the queue partitions, session pool and thread list it uses are never destroyed
+		for (size_t i = 0; i < mailThreads.size(); i++)
+		{
+			while (mailThreads.at(i)->isRunning() && std::chrono::steady_clock::now() < stopBy)
+				std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+			if (!mailThreads.at(i)->isRunning())
+				delete mailThreads.at(i);
+		}
+
+		mailThreads.clear();
 	}
 
 
 	FB_BIGINT MessageServer::addServer(const std::string &serverName, const PortNumber port, const std::string &userName,
 		const std::string &password, const std::string database, int securityType)
 	{
-		std::lock_guard<std::mutex> guard(serverListLockMutex);
-
 		switch (securityType)
 		{
 			case 0:
@@ -71,69 +106,43 @@ namespace FBMailUDF
 				securityType = 0;
 		}
 
-		time_t currentTime;
-		time(&currentTime);
-
-		MailServer newServer = MailServer(static_cast<FB_BIGINT>(currentTime), serverName, port, 
+		// the registry allocates the server id when the server is added
+		MailServer newServer = MailServer(0, serverName, port, 
 			static_cast<SMTP_SECURITY_TYPE>(securityType), userName, password, database);
 		EMailResult isValid = newServer.isValidServer();
 		
 		if (isValid != EMailResult::Success)
 			return (isValid);
 
-		for (size_t i = 0; i < messageServers.size(); i++)
-		{
-			if (messageServers.at(i) == newServer)
-			{
-				return (messageServers.at(i).getServerID());
-			}
-		}
-
-		messageServers.push_back(newServer);
-		return (newServer.getServerID());
+		return (serverRegistry.add(newServer));
 	}
 
 	EMailResult MessageServer::removeServer(FB_BIGINT mailServer)
 	{
-		std::lock_guard<std::mutex> guard(serverListLockMutex);
-
-		for (size_t i = 0; i < messageServers.size(); i++)
-		{
-			if (messageServers.at(i).getServerID() == mailServer)
-			{
-				messageServers.erase(messageServers.cbegin() + i);
-
-				return (EMailResult::Success);
-			}
-		}
+		if (serverRegistry.remove(mailServer))
+			return (EMailResult::Success);
 
 		return (EMailResult::ServerNotFound);
 	}
 
 	EMailResult MessageServer::sendMessage(const FB_BIGINT serverID, const FB_BIGINT id, const std::string &senderName, 
 		const std::string &senderEmail, const std::string &recipientName, const std::string &recipientEmail, 
-		const std::string &subject, const std::string &message, const int priority, const bool immediate)
+		const std::string &subject, const std::string &message, const int priority, const bool immediate,
+		const int deadline)
 	{
-		MailServer *server = nullptr;
-
-		{
-			std::lock_guard<std::mutex> guard(serverListLockMutex);
-
-			for (size_t i = 0; i < messageServers.size(); i++)
-			{
-				if (messageServers.at(i).getServerID() == serverID)
-				{
-					server = &messageServers.at(i);
-					break;
-				}
-			}
-		}
+		MailServerHandle server = serverRegistry.find(serverID);
 
 		if (server == nullptr)
 			return (EMailResult::InvalidServer);
 
-		FBMailUDF::MailMessage msg = FBMailUDF::MailMessage(*server, id, senderName, senderEmail, 
-			recipientName, recipientEmail, subject, message, priority);
+		// the deadline is the number of seconds within which the message should be sent
+		time_t sendBy = 0;
+
+		if (deadline > 0)
+			sendBy = time(NULL) + deadline;
+
+		FBMailUDF::MailMessage msg = FBMailUDF::MailMessage(server, id, senderName, senderEmail, 
+			recipientName, recipientEmail, subject, message, priority, sendBy);
 
 		FBMailUDF::EMailResult check = msg.canSend();
 
@@ -141,17 +150,12 @@ namespace FBMailUDF
 		{
 			if (immediate)
 			{
-				return (mailThread.sendImmediate(msg));
+				return (mailThreads.front()->sendImmediate(msg));
 			}
 			else
 			{
-				MessageSendThread::messageAdd(msg);
-
-				if (!ManagedThreads::ManagedThread::exists(SMTP_THREAD_NAME))
-				{
-					mailThread.addMailListener(this);
-					mailThread.start();
-				}
+				MessageSendThread::messageAdd(std::move(msg));
+				wakeSendThread();
 			}
 		}
 
@@ -161,40 +165,162 @@ namespace FBMailUDF
 	EMailResult MessageServer::messageSendResult(const FB_BIGINT serverID, const FB_BIGINT emailID, const bool eraseMessage, 
 		std::string &sendResult, int &errorCode)
 	{
-		std::lock_guard<std::mutex> guard(resultListLockMutex);
-		
-		for (size_t i = 0; i < resultList.size(); i++)
+		return (resultStore.find(serverID, emailID, eraseMessage, sendResult, errorCode));
+	}
+
+	int MessageServer::messageCount(const std::string &database, const bool cancelAll, const int sleepDelay)
+	{
+		int Result = MessageSendThread::messageQueueCount(database, cancelAll);
+
+		if (Result > 0 && sleepDelay > 0)
+			std::this_thread::sleep_for(chrono::milliseconds(sleepDelay > MAX_SLEEP_DELAY ? MAX_SLEEP_DELAY : sleepDelay));
+
+		return (Result);
+	}
+
+	FB_BIGINT MessageServer::statistic(const int statistic)
+	{
+		switch (statistic)
 		{
-			MailSendResult result = resultList.at(i);
+			case EMailStatistic::TlsFullHandshakes:
+				return (CSmtp::GetFullHandshakeCount());
 
-			if (result.getServerID() == serverID && result.getMessageID() == emailID)
-			{
-				sendResult = result.getErrorMessage();
-				errorCode = result.getErrorCode();
+			case EMailStatistic::TlsResumedHandshakes:
+				return (CSmtp::GetResumedHandshakeCount());
+
+			case EMailStatistic::AttachmentCacheHits:
+				return (AttachmentCache::getHits());
+
+			case EMailStatistic::AttachmentCacheMisses:
+				return (AttachmentCache::getMisses());
 
-				if (eraseMessage)
-					resultList.erase(resultList.cbegin() + i);
+			case EMailStatistic::AttachmentCacheHitRate:
+				return (AttachmentCache::getHitRate());
 
-				return (result.getSendResult());
+			case EMailStatistic::AttachmentCacheBytesSaved:
+				return (AttachmentCache::getBytesSaved());
+
+			default:
+				return (EMailResult::InvalidStatistic);
+		}
+	}
+
+	EMailResult MessageServer::setOption(const int option, const int value)
+	{
+		switch (option)
+		{
+			case EMailOption::SendThreadCount:
+				return (setSendThreadCount(value));
+
+			case EMailOption::RetryLimit:
+				return (RetryPolicy::setRetryLimit(value));
+
+			case EMailOption::RetryDelay:
+				return (RetryPolicy::setRetryDelay(value));
+
+			case EMailOption::GroupWindow:
+				return (RecipientGrouping::setWindow(value));
+
+			case EMailOption::CombineRecipients:
+				return (RecipientGrouping::setCombineRecipients(value));
+
+			case EMailOption::AttachmentCacheSize:
+				return (AttachmentCache::setCacheSize(value));
+
+			default:
+				return (EMailResult::InvalidOption);
+		}
+	}
+
+	EMailResult MessageServer::setServerOption(const FB_BIGINT serverID, const int option, const int value)
+	{
+		MailServerHandle server = serverRegistry.find(serverID);
+
+		if (server == nullptr)
+			return (EMailResult::ServerNotFound);
+
+		switch (option)
+		{
+			case EServerOption::MaxSessions:
+				return (server->getState()->setMaxSessions(value));
+
+			case EServerOption::RateBurst:
+				return (server->getState()->getRateLimit().setBurst(value));
+
+			case EServerOption::RatePerMinute:
+				return (server->getState()->getRateLimit().setRatePerMinute(value));
+
+			case EServerOption::DailyQuota:
+				return (server->getState()->getRateLimit().setDailyQuota(value));
+
+			case EServerOption::BreakerFailures:
+				return (server->getState()->getBreaker().setFailureThreshold(value));
+
+			case EServerOption::BreakerProbeInterval:
+				return (server->getState()->getBreaker().setProbeInterval(value));
+
+			default:
+				return (EMailResult::InvalidOption);
+		}
+	}
+
+	EMailResult MessageServer::setDatabaseWeight(const std::string &database, const int weight)
+	{
+		return (MessageSendThread::setDatabaseWeight(database, weight));
+	}
+
+	// private methods
+
+	void MessageServer::wakeSendThread()
+	{
+		int threadCount = sendThreadCount;
+
+		// wake an idle send thread so the message is sent straight away
+		for (int i = 0; i < threadCount; i++)
+		{
+			if (mailThreads.at(i)->isActive() && !mailThreads.at(i)->isSending())
+			{
+				mailThreads.at(i)->wake();
+				return;
+			}
+		}
+
+		// start one more send thread each time a message is queued until
+		// all of the configured send threads are running
+		for (int i = 0; i < threadCount; i++)
+		{
+			if (!mailThreads.at(i)->isActive())
+			{
+				mailThreads.at(i)->start();
+				return;
 			}
 		}
 
-		return (EMailResult::NotFound);
+		// every thread is sending, they check the queue again before waiting
+		// but may have just done so, waking them ensures the message is seen
+		for (int i = 0; i < threadCount; i++)
+			mailThreads.at(i)->wake();
 	}
 
-	int MessageServer::messageCount(const std::string &database, const bool cancelAll, const int sleepDelay)
+	EMailResult MessageServer::setSendThreadCount(const int value)
 	{
-		int Result = mailThread.messageQueueCount(database, cancelAll);
+		if (value < 1 || value > MAX_SEND_THREAD_COUNT)
+			return (EMailResult::InvalidOptionValue);
 
-		if (Result > 0 && sleepDelay > 0)
-			std::this_thread::sleep_for(chrono::milliseconds(sleepDelay > MAX_SLEEP_DELAY ? MAX_SLEEP_DELAY : sleepDelay));
+		std::lock_guard<std::mutex> guard(threadListLockMutex);
 
-		return (Result);
+		// threads no longer required finish the message they are sending and stop, 
+		// any messages they had not sent are returned to the queue
+		for (size_t i = value; i < mailThreads.size(); i++)
+			mailThreads.at(i)->cancel();
+
+		sendThreadCount = value;
+
+		return (EMailResult::Success);
 	}
 
 	void MessageServer::Notify(MailSendResult messageResult)
 	{
-		std::lock_guard<std::mutex> guard(resultListLockMutex);
-		resultList.push_back(messageResult);
+		resultStore.add(messageResult);
 	}
 }
@@ -37,11 +37,17 @@
 
 #include <mutex>
 #include <chrono>
+#include <atomic>
 #include "Global.h"
 #include "ManagedThread.h"
 #include "MailServer.h"
+#include "MailServerRegistry.h"
 #include "MailMessage.h"
 #include "MessageSendThread.h"
+#include "MailSendResultStore.h"
+#include "RetryPolicy.h"
+#include "RecipientGrouping.h"
+#include "AttachmentCache.h"
 
 
 namespace FBMailUDF
@@ -49,9 +55,13 @@ namespace FBMailUDF
 	class MessageServer : private MailSendNotification
 	{
 	private:
-		MailServerList messageServers;
-		MessageSendThread mailThread;
-		MailSendResultList resultList;
+		MailServerRegistry serverRegistry;
+		std::vector<MessageSendThread*> mailThreads;
+		std::atomic<int> sendThreadCount;
+		MailSendResultStore resultStore;
+
+		void wakeSendThread();
+		EMailResult setSendThreadCount(const int value);
 	public:
 		MessageServer();
 		MessageServer(const MessageServer &copy);
@@ -61,11 +71,17 @@ namespace FBMailUDF
 		EMailResult removeServer(FB_BIGINT mailServer);
 		EMailResult sendMessage(const FB_BIGINT serverID, const FB_BIGINT id, const std::string &senderName,
 			const std::string &senderEmail, const std::string &recipientName, const std::string &recipientEmail,
-			const std::string &subject, const std::string &message, const int priority, const bool immediate);
+			const std::string &subject, const std::string &message, const int priority, const bool immediate,
+			const int deadline);
 		int messageCount(const std::string &database, const bool cancelAll, const int sleepDelay);
 		EMailResult messageSendResult(const FB_BIGINT serverID, const FB_BIGINT emailID, const bool eraseMessage,
 			std::string &sendResult, int &errorCode);
 
+		FB_BIGINT statistic(const int statistic);
+		EMailResult setOption(const int option, const int value);
+		EMailResult setServerOption(const FB_BIGINT serverID, const int option, const int value);
+		EMailResult setDatabaseWeight(const std::string &database, const int weight);
+
 		void Notify(MailSendResult messageResult);
 	};
 }
@@ -0,0 +1,292 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+* MIT License
+*
+* Copyright (c) 2017 Simon Carter (s1cart3r@gmail.com)
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*
+* The Original Code was created by Simon Carter (s1cart3r@gmail.com).
+*
+* Module:  fbSMTPUDF - Firebird UDF Library for sending emails.
+*
+* Description: Messages queued for a single database, with their own lock
+*			   and counters so one database never waits on another.
+*
+* Date: 17/10/2026
+*
+*/
+
+
+#include "QueuePartition.h"
+
+namespace FBMailUDF
+{
+	QueuePartition::QueuePartition(const std::string &database)
+		: database(database), stagedMessages(nullptr), queuedCount(0), inFlightCount(0), 
+		deficit(0), weight(DEFAULT_DATABASE_WEIGHT)
+	{
+
+	}
+
+	QueuePartition::~QueuePartition()
+	{
+		cancel();
+	}
+
+	// static methods
+
+	QueuePartition* QueuePartition::claimNextBatch(const std::vector<QueuePartition*> &partitions, 
+		std::atomic<size_t> &next, MailServerHandle &server, MailMessageList &batch, 
+		std::chrono::steady_clock::time_point &available)
+	{
+		if (partitions.empty())
+			return (nullptr);
+
+		// deficit round robin, each database can send as many messages as its deficit
+		// before the next database is given a turn.  When no database with a deficit 
+		// can send, each is given its quantum and the partitions are tried once more
+		for (int round = 0; round < 2; round++)
+		{
+			size_t start = next;
+
+			for (size_t i = 0; i < partitions.size(); i++)
+			{
+				size_t index = (start + i) % partitions.size();
+				QueuePartition *candidate = partitions.at(index);
+				int deficit = candidate->getDeficit();
+
+				if (deficit <= 0)
+					continue;
+
+				size_t maxMessages = static_cast<size_t>(deficit) < MAX_MESSAGES_PER_SESSION ? 
+					static_cast<size_t>(deficit) : MAX_MESSAGES_PER_SESSION;
+
+				if (candidate->claimBatch(server, batch, maxMessages, available))
+				{
+					candidate->consumeDeficit(static_cast<int>(batch.size()));
+
+					// the same database keeps its turn until its deficit is used
+					next = candidate->getDeficit() > 0 ? index : index + 1;
+					return (candidate);
+				}
+			}
+
+			for (size_t i = 0; i < partitions.size(); i++)
+				partitions.at(i)->addQuantum();
+		}
+
+		return (nullptr);
+	}
+
+	// methods
+
+	void QueuePartition::push(MailMessage &&message)
+	{
+		StagedMessage *staged = new StagedMessage();
+		staged->message = std::move(message);
+		staged->message.setQueuedTime(std::chrono::steady_clock::now());
+		staged->next = stagedMessages.load();
+
+		// counted before it can be claimed, so the count never drops below the 
+		// number of messages waiting to be sent
+		queuedCount++;
+
+		while (!stagedMessages.compare_exchange_weak(staged->next, staged));
+	}
+
+	bool QueuePartition::claimBatch(MailServerHandle &server, MailMessageList &batch, const size_t maxMessages,
+		std::chrono::steady_clock::time_point &available)
+	{
+		std::lock_guard<std::mutex> guard(partitionLock);
+
+		moveStagedMessages();
+		moveDueRetries(available);
+
+		if (!messages.claimBatch(server, batch, maxMessages, available))
+			return (false);
+
+		// messages being sent are still counted until their result is known, they 
+		// are added to the in flight count first so the total never drops to zero early
+		inFlightCount += static_cast<int>(batch.size());
+		queuedCount -= static_cast<int>(batch.size());
+
+		return (true);
+	}
+
+	void QueuePartition::returnUnsent(MailMessageList &batch, const size_t sent)
+	{
+		if (sent >= batch.size())
+			return;
+
+		std::lock_guard<std::mutex> guard(partitionLock);
+
+		for (size_t i = sent; i < batch.size(); i++)
+			messages.push(std::move(batch.at(i)));
+
+		queuedCount += static_cast<int>(batch.size() - sent);
+		inFlightCount -= static_cast<int>(batch.size() - sent);
+
+		// the database was charged for the whole batch when it was claimed
+		refundDeficit(static_cast<int>(batch.size() - sent));
+	}
+
+	void QueuePartition::retryMessage(MailMessage &&message, const time_t retryTime)
+	{
+		std::lock_guard<std::mutex> guard(partitionLock);
+
+		retryMessages.emplace(retryTime, std::move(message));
+
+		queuedCount++;
+		inFlightCount--;
+	}
+
+	void QueuePartition::messageCompleted()
+	{
+		// the result has already been published, so once the count reaches zero
+		// the results for every message are available
+		inFlightCount--;
+	}
+
+	int QueuePartition::count()
+	{
+		return (queuedCount + inFlightCount);
+	}
+
+	int QueuePartition::getDeficit()
+	{
+		return (deficit);
+	}
+
+	void QueuePartition::consumeDeficit(const int value)
+	{
+		deficit -= value;
+	}
+
+	void QueuePartition::refundDeficit(const int value)
+	{
+		// messages which never reached the server are not charged, otherwise a database
+		// whose server is failing loses its share of later rounds
+		deficit += value;
+	}
+
+	void QueuePartition::addQuantum()
+	{
+		// a database with nothing queued does not save up a share it could later use 
+		// to send ahead of every other database
+		int quantum = weight * DATABASE_QUANTUM;
+
+		if (queuedCount == 0)
+		{
+			deficit = 0;
+			return;
+		}
+
+		int current = deficit.load();
+
+		while (!deficit.compare_exchange_weak(current, current > 0 ? quantum : current + quantum));
+	}
+
+	EMailResult QueuePartition::setWeight(const int value)
+	{
+		if (value < 1 || value > MAX_DATABASE_WEIGHT)
+			return (EMailResult::InvalidOptionValue);
+
+		weight = value;
+
+		return (EMailResult::Success);
+	}
+
+	int QueuePartition::cancel()
+	{
+		// removed messages are released once the lock is no longer held
+		MessageQueue removed;
+		std::multimap<time_t, MailMessage> removedRetries;
+
+		{
+			std::lock_guard<std::mutex> guard(partitionLock);
+
+			moveStagedMessages();
+			messages.swap(removed);
+			retryMessages.swap(removedRetries);
+		}
+
+		int Result = static_cast<int>(removed.size() + removedRetries.size());
+		queuedCount -= Result;
+
+		return (Result);
+	}
+
+	const std::string &QueuePartition::getDatabase()
+	{
+		return (database);
+	}
+
+	// private methods
+
+	void QueuePartition::moveStagedMessages()
+	{
+		// the caller must hold partitionLock
+		StagedMessage *staged = stagedMessages.exchange(nullptr);
+		StagedMessage *ordered = nullptr;
+
+		// the stack holds the newest message first, reverse it so messages 
+		// are added to the queue in the order they were queued
+		while (staged != nullptr)
+		{
+			StagedMessage *next = staged->next;
+			staged->next = ordered;
+			ordered = staged;
+			staged = next;
+		}
+
+		while (ordered != nullptr)
+		{
+			StagedMessage *next = ordered->next;
+			messages.push(std::move(ordered->message));
+			delete ordered;
+			ordered = next;
+		}
+	}
+
+	void QueuePartition::moveDueRetries(std::chrono::steady_clock::time_point &available)
+	{
+		// the caller must hold partitionLock
+		if (retryMessages.empty())
+			return;
+
+		time_t now = time(NULL);
+		std::multimap<time_t, MailMessage>::iterator it = retryMessages.begin();
+
+		// retried messages keep their sequence so they return to their original place
+		while (it != retryMessages.end() && it->first <= now)
+		{
+			messages.push(std::move(it->second));
+			it = retryMessages.erase(it);
+		}
+
+		if (it != retryMessages.end())
+		{
+			std::chrono::steady_clock::time_point retryAt = std::chrono::steady_clock::now() + 
+				std::chrono::seconds(it->first - now);
+
+			if (retryAt < available)
+				available = retryAt;
+		}
+	}
+}
@@ -0,0 +1,112 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+* MIT License
+*
+* Copyright (c) 2017 Simon Carter (s1cart3r@gmail.com)
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*
+* The Original Code was created by Simon Carter (s1cart3r@gmail.com).
+*
+* Module:  fbSMTPUDF - Firebird UDF Library for sending emails.
+*
+* Description: Messages queued for a single database, with their own lock
+*			   and counters so one database never waits on another.
+*
+* Date: 17/10/2026
+*
+*/
+
+
+#ifndef FB_SMTP__QUEUE_PARTITION
+#define FB_SMTP__QUEUE_PARTITION
+
+#include <mutex>
+#include <atomic>
+#include <map>
+#include <vector>
+
+#include "Global.h"
+#include "MailMessage.h"
+#include "MessageQueue.h"
+
+namespace FBMailUDF
+{
+	class QueuePartition
+	{
+	private:
+		// messages are queued by pushing them on to a lock free stack, the send threads 
+		// take the whole stack at once and move it in to the queue
+		struct StagedMessage
+		{
+			MailMessage message;
+			StagedMessage *next;
+		};
+
+		std::string database;
+		std::atomic<StagedMessage*> stagedMessages;
+		std::mutex partitionLock;
+		MessageQueue messages;
+
+		// messages waiting to be retried, by the time they can next be sent
+		std::multimap<time_t, MailMessage> retryMessages;
+
+		// counters are read without taking the partition lock
+		std::atomic<int> queuedCount;
+		std::atomic<int> inFlightCount;
+
+		// messages the partition can still send in the current round of the scheduler
+		std::atomic<int> deficit;
+		std::atomic<int> weight;
+
+		void moveStagedMessages();
+		void moveDueRetries(std::chrono::steady_clock::time_point &available);
+
+		// prevent class copying
+		QueuePartition(const QueuePartition&);
+		QueuePartition& operator=(const QueuePartition&);
+	public:
+		QueuePartition(const std::string &database);
+		~QueuePartition();
+
+		void push(MailMessage &&message);
+		bool claimBatch(MailServerHandle &server, MailMessageList &batch, const size_t maxMessages,
+			std::chrono::steady_clock::time_point &available);
+		void returnUnsent(MailMessageList &batch, const size_t sent);
+		void retryMessage(MailMessage &&message, const time_t retryTime);
+		void messageCompleted();
+
+		int count();
+
+		int getDeficit();
+		void consumeDeficit(const int value);
+		void refundDeficit(const int value);
+		void addQuantum();
+		EMailResult setWeight(const int value);
+		int cancel();
+		const std::string &getDatabase();
+
+		// deficit round robin, claims the next batch from the partition whose turn it is,
+		// returns the partition claimed from or nullptr if none of them can send
+		static QueuePartition* claimNextBatch(const std::vector<QueuePartition*> &partitions, 
+			std::atomic<size_t> &next, MailServerHandle &server, MailMessageList &batch,
+			std::chrono::steady_clock::time_point &available);
+	};
+}
+
+#endif
@@ -0,0 +1,137 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+* MIT License
+*
+* Copyright (c) 2017 Simon Carter (s1cart3r@gmail.com)
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*
+* The Original Code was created by Simon Carter (s1cart3r@gmail.com).
+*
+* Module:  fbSMTPUDF - Firebird UDF Library for sending emails.
+*
+* Description: Groups the messages sent over a session by recipient domain
+*			   and content.
+*
+* Date: 17/10/2026
+*
+*/
+
+
+#include <algorithm>
+#include <limits>
+
+#include "RecipientGrouping.h"
+#include "MessageQueue.h"
+
+namespace FBMailUDF
+{
+	std::atomic<int> groupWindow(DEFAULT_GROUP_WINDOW);
+	std::atomic<bool> combineRecipients(false);
+
+	std::chrono::milliseconds RecipientGrouping::getWindow()
+	{
+		return (std::chrono::milliseconds(groupWindow));
+	}
+
+	EMailResult RecipientGrouping::setWindow(const int value)
+	{
+		if (value < 0 || value > MAX_GROUP_WINDOW)
+			return (EMailResult::InvalidOptionValue);
+
+		groupWindow = value;
+
+		return (EMailResult::Success);
+	}
+
+	EMailResult RecipientGrouping::setCombineRecipients(const int value)
+	{
+		if (value < 0 || value > 1)
+			return (EMailResult::InvalidOptionValue);
+
+		combineRecipients = value == 1;
+
+		return (EMailResult::Success);
+	}
+
+	// domain names are not case sensitive, only ascii letters are folded as anything else
+	// in a domain name has been encoded
+	int compareDomain(const std::string_view &a, const std::string_view &b)
+	{
+		size_t length = a.size() < b.size() ? a.size() : b.size();
+
+		for (size_t i = 0; i < length; i++)
+		{
+			int left = a[i] >= 'A' && a[i] <= 'Z' ? a[i] + ('a' - 'A') : static_cast<unsigned char>(a[i]);
+			int right = b[i] >= 'A' && b[i] <= 'Z' ? b[i] + ('a' - 'A') : static_cast<unsigned char>(b[i]);
+
+			if (left != right)
+				return (left < right ? -1 : 1);
+		}
+
+		if (a.size() == b.size())
+			return (0);
+
+		return (a.size() < b.size() ? -1 : 1);
+	}
+
+	void RecipientGrouping::sortByDomain(MailMessageList &batch, const size_t first)
+	{
+		// the batch is claimed in priority lane and deadline order, messages are only 
+		// moved next to others for the same domain within the same lane and deadline, so
+		// a message is never sent after one the queue would have sent later.  The sort is 
+		// stable so within a domain messages keep the order they were queued
+		std::stable_sort(batch.begin() + first, batch.end(), 
+			[](const MailMessage &a, const MailMessage &b) 
+			{
+				int laneA = MessageQueue::getLane(a.getPriority());
+				int laneB = MessageQueue::getLane(b.getPriority());
+
+				if (laneA != laneB)
+					return (laneA < laneB);
+
+				// messages without a deadline are sent after those with one
+				time_t deadlineA = a.getDeadline() > 0 ? a.getDeadline() : std::numeric_limits<time_t>::max();
+				time_t deadlineB = b.getDeadline() > 0 ? b.getDeadline() : std::numeric_limits<time_t>::max();
+
+				if (deadlineA != deadlineB)
+					return (deadlineA < deadlineB);
+
+				return (compareDomain(a.getRecipientDomain(), b.getRecipientDomain()) < 0);
+			});
+	}
+
+	size_t RecipientGrouping::groupSize(MailMessageList &batch, const size_t first)
+	{
+		size_t Result = 1;
+
+		if (!combineRecipients)
+			return (Result);
+
+		// only messages next to each other are compared, identical messages for a domain 
+		// are usually queued together and the batch has been sorted by domain
+		while (first + Result < batch.size() && Result < MAX_RECIPIENTS_PER_TRANSACTION &&
+			compareDomain(batch.at(first + Result).getRecipientDomain(), batch.at(first).getRecipientDomain()) == 0 &&
+			batch.at(first + Result).hasSameContent(batch.at(first)))
+		{
+			Result++;
+		}
+
+		return (Result);
+	}
+}
@@ -0,0 +1,63 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+* MIT License
+*
+* Copyright (c) 2017 Simon Carter (s1cart3r@gmail.com)
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*
+* The Original Code was created by Simon Carter (s1cart3r@gmail.com).
+*
+* Module:  fbSMTPUDF - Firebird UDF Library for sending emails.
+*
+* Description: Groups the messages sent over a session by recipient domain
+*			   and content.
+*
+* Date: 17/10/2026
+*
+*/
+
+
+#ifndef FB_SMTP__RECIPIENT_GROUPING
+#define FB_SMTP__RECIPIENT_GROUPING
+
+#include <atomic>
+#include <chrono>
+
+#include "Global.h"
+#include "MailMessage.h"
+
+namespace FBMailUDF
+{
+	// queued messages are held for a short time so a burst of messages for a server can be
+	// claimed and sent over one session, the batch is sent a recipient domain at a time and
+	// if enabled, messages with identical content are sent in one transaction with one 
+	// RCPT for each recipient
+	class RecipientGrouping
+	{
+	public:
+		static std::chrono::milliseconds getWindow();
+		static EMailResult setWindow(const int value);
+		static EMailResult setCombineRecipients(const int value);
+
+		static void sortByDomain(MailMessageList &batch, const size_t first);
+		static size_t groupSize(MailMessageList &batch, const size_t first);
+	};
+}
+
+#endif
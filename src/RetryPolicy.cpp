@@ -0,0 +1,109 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+* MIT License
+*
+* Copyright (c) 2017 Simon Carter (s1cart3r@gmail.com)
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*
+* The Original Code was created by Simon Carter (s1cart3r@gmail.com).
+*
+* Module:  fbSMTPUDF - Firebird UDF Library for sending emails.
+*
+* Description: Decides which failed sends are retried and when.
+*
+* Date: 17/10/2026
+*
+*/
+
+
+#include <random>
+
+#include "RetryPolicy.h"
+
+namespace FBMailUDF
+{
+	std::atomic<int> retryLimit(DEFAULT_RETRY_LIMIT);
+	std::atomic<int> retryDelay(DEFAULT_RETRY_DELAY);
+
+	bool RetryPolicy::isTransient(const ECSmtp &error)
+	{
+		int replyCode = error.GetReplyCode();
+
+		if (replyCode > 0)
+			return (replyCode >= 400 && replyCode < 500);
+
+		switch (error.GetErrorNum())
+		{
+			case ECSmtp::WSA_CONNECT:
+			case ECSmtp::WSA_SEND:
+			case ECSmtp::WSA_RECV:
+			case ECSmtp::WSA_SELECT:
+			case ECSmtp::CONNECTION_CLOSED:
+			case ECSmtp::SERVER_NOT_READY:
+			case ECSmtp::SERVER_NOT_RESPONDING:
+			case ECSmtp::SELECT_TIMEOUT:
+				return (true);
+
+			default:
+				return (false);
+		}
+	}
+
+	bool RetryPolicy::canRetry(const int attempts)
+	{
+		return (attempts <= retryLimit);
+	}
+
+	time_t RetryPolicy::nextAttempt(const int attempts)
+	{
+		static thread_local std::mt19937 generator(std::random_device{}());
+
+		// the delay doubles with each attempt, the retry is made at a random 
+		// point between half and all of the delay
+		int shift = attempts > 1 ? attempts - 1 : 0;
+		long long delay = static_cast<long long>(retryDelay) << (shift < 20 ? shift : 20);
+
+		if (delay > MAX_RETRY_DELAY)
+			delay = MAX_RETRY_DELAY;
+
+		std::uniform_int_distribution<long long> jitter(delay / 2, delay);
+
+		return (time(NULL) + static_cast<time_t>(jitter(generator)));
+	}
+
+	EMailResult RetryPolicy::setRetryLimit(const int value)
+	{
+		if (value < 0 || value > MAX_RETRY_LIMIT)
+			return (EMailResult::InvalidOptionValue);
+
+		retryLimit = value;
+
+		return (EMailResult::Success);
+	}
+
+	EMailResult RetryPolicy::setRetryDelay(const int value)
+	{
+		if (value < 1 || value > MAX_RETRY_DELAY)
+			return (EMailResult::InvalidOptionValue);
+
+		retryDelay = value;
+
+		return (EMailResult::Success);
+	}
+}
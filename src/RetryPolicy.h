@@ -0,0 +1,61 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+* MIT License
+*
+* Copyright (c) 2017 Simon Carter (s1cart3r@gmail.com)
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*
+* The Original Code was created by Simon Carter (s1cart3r@gmail.com).
+*
+* Module:  fbSMTPUDF - Firebird UDF Library for sending emails.
+*
+* Description: Decides which failed sends are retried and when.
+*
+* Date: 17/10/2026
+*
+*/
+
+
+#ifndef FB_SMTP__RETRY_POLICY
+#define FB_SMTP__RETRY_POLICY
+
+#include <atomic>
+#include <time.h>
+
+#include "Global.h"
+#include "CSmtp.h"
+
+namespace FBMailUDF
+{
+	// a failure is transient if the server replied with a 4xx code or the connection 
+	// failed or timed out, transient failures are retried with an exponential backoff 
+	// which is jittered so messages failing together are not retried together
+	class RetryPolicy
+	{
+	public:
+		static bool isTransient(const ECSmtp &error);
+		static bool canRetry(const int attempts);
+		static time_t nextAttempt(const int attempts);
+
+		static EMailResult setRetryLimit(const int value);
+		static EMailResult setRetryDelay(const int value);
+	};
+}
+
+#endif
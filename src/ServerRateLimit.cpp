@@ -0,0 +1,176 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+* MIT License
+*
+* Copyright (c) 2017 Simon Carter (s1cart3r@gmail.com)
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*
+* The Original Code was created by Simon Carter (s1cart3r@gmail.com).
+*
+* Module:  fbSMTPUDF - Firebird UDF Library for sending emails.
+*
+* Description: Token bucket and daily quota limiting how quickly messages
+*			   are sent to a server.
+*
+* Date: 17/10/2026
+*
+*/
+
+
+#include "ServerRateLimit.h"
+
+namespace FBMailUDF
+{
+	const time_t SECONDS_PER_DAY = 86400;
+
+	ServerRateLimit::ServerRateLimit()
+		: burst(DEFAULT_SERVER_RATE_BURST), ratePerMinute(0), dailyQuota(0), tokens(DEFAULT_SERVER_RATE_BURST),
+		lastRefill(std::chrono::steady_clock::now()), quotaDay(time(NULL) / SECONDS_PER_DAY), sentToday(0)
+	{
+
+	}
+
+	ServerRateLimit::~ServerRateLimit()
+	{
+
+	}
+
+	void ServerRateLimit::refill(const std::chrono::steady_clock::time_point &now)
+	{
+		std::chrono::duration<double> elapsed = now - lastRefill;
+		lastRefill = now;
+
+		tokens += elapsed.count() * ratePerMinute / 60.0;
+
+		if (tokens > burst)
+			tokens = burst;
+
+		time_t today = time(NULL) / SECONDS_PER_DAY;
+
+		if (today != quotaDay)
+		{
+			quotaDay = today;
+			sentToday = 0;
+		}
+	}
+
+	int ServerRateLimit::tryAcquire(const int requested, std::chrono::steady_clock::time_point &available)
+	{
+		std::lock_guard<std::mutex> guard(limitLock);
+
+		std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+		refill(now);
+
+		int Result = requested;
+
+		if (dailyQuota > 0 && dailyQuota - sentToday < Result)
+			Result = dailyQuota - sentToday;
+
+		if (Result < 1)
+		{
+			// nothing more can be sent until the quota is reset at midnight
+			available = now + std::chrono::seconds(SECONDS_PER_DAY - time(NULL) % SECONDS_PER_DAY);
+			return (0);
+		}
+
+		if (ratePerMinute > 0)
+		{
+			if (static_cast<int>(tokens) < Result)
+				Result = static_cast<int>(tokens);
+
+			if (Result < 1)
+			{
+				// the time until a whole token has been added
+				available = now + std::chrono::milliseconds(static_cast<long long>(
+					(1.0 - tokens) * 60000.0 / ratePerMinute) + 1);
+				return (0);
+			}
+
+			tokens -= Result;
+		}
+
+		sentToday += Result;
+
+		return (Result);
+	}
+
+	void ServerRateLimit::refund(const int count)
+	{
+		if (count < 1)
+			return;
+
+		std::lock_guard<std::mutex> guard(limitLock);
+
+		// messages which were not sent are returned to the queue, they are counted
+		// again when they are next claimed
+		if (ratePerMinute > 0)
+		{
+			tokens += count;
+
+			if (tokens > burst)
+				tokens = burst;
+		}
+
+		sentToday = sentToday > count ? sentToday - count : 0;
+	}
+
+	int ServerRateLimit::getSentToday()
+	{
+		std::lock_guard<std::mutex> guard(limitLock);
+		refill(std::chrono::steady_clock::now());
+		return (sentToday);
+	}
+
+	EMailResult ServerRateLimit::setBurst(const int value)
+	{
+		if (value < 1)
+			return (EMailResult::InvalidOptionValue);
+
+		std::lock_guard<std::mutex> guard(limitLock);
+		burst = value;
+
+		if (tokens > burst)
+			tokens = burst;
+
+		return (EMailResult::Success);
+	}
+
+	EMailResult ServerRateLimit::setRatePerMinute(const int value)
+	{
+		if (value < 0)
+			return (EMailResult::InvalidOptionValue);
+
+		std::lock_guard<std::mutex> guard(limitLock);
+		refill(std::chrono::steady_clock::now());
+		ratePerMinute = value;
+
+		return (EMailResult::Success);
+	}
+
+	EMailResult ServerRateLimit::setDailyQuota(const int value)
+	{
+		if (value < 0)
+			return (EMailResult::InvalidOptionValue);
+
+		std::lock_guard<std::mutex> guard(limitLock);
+		dailyQuota = value;
+
+		return (EMailResult::Success);
+	}
+}
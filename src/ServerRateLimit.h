@@ -0,0 +1,82 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+* MIT License
+*
+* Copyright (c) 2017 Simon Carter (s1cart3r@gmail.com)
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*
+* The Original Code was created by Simon Carter (s1cart3r@gmail.com).
+*
+* Module:  fbSMTPUDF - Firebird UDF Library for sending emails.
+*
+* Description: Token bucket and daily quota limiting how quickly messages
+*			   are sent to a server.
+*
+* Date: 17/10/2026
+*
+*/
+
+
+#ifndef FB_SMTP__SERVER_RATE_LIMIT
+#define FB_SMTP__SERVER_RATE_LIMIT
+
+#include <mutex>
+#include <chrono>
+#include <time.h>
+
+#include "Global.h"
+
+namespace FBMailUDF
+{
+	// tokens are added at the sustained rate up to the burst size, one token is taken for 
+	// each message sent.  The daily quota counts messages sent since midnight UTC.  A rate
+	// or quota of zero is not limited.
+	class ServerRateLimit
+	{
+	private:
+		std::mutex limitLock;
+		int burst;
+		int ratePerMinute;
+		int dailyQuota;
+		double tokens;
+		std::chrono::steady_clock::time_point lastRefill;
+		time_t quotaDay;
+		int sentToday;
+
+		void refill(const std::chrono::steady_clock::time_point &now);
+
+		// prevent class copying
+		ServerRateLimit(const ServerRateLimit&);
+		ServerRateLimit& operator=(const ServerRateLimit&);
+	public:
+		ServerRateLimit();
+		~ServerRateLimit();
+
+		int tryAcquire(const int requested, std::chrono::steady_clock::time_point &available);
+		void refund(const int count);
+
+		int getSentToday();
+
+		EMailResult setBurst(const int value);
+		EMailResult setRatePerMinute(const int value);
+		EMailResult setDailyQuota(const int value);
+	};
+}
+
+#endif
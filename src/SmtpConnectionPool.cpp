@@ -0,0 +1,200 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+* MIT License
+*
+* Copyright (c) 2017 Simon Carter (s1cart3r@gmail.com)
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*
+* The Original Code was created by Simon Carter (s1cart3r@gmail.com).
+*
+* Module:  fbSMTPUDF - Firebird UDF Library for sending emails.
+*
+* Description: Pool of open, authenticated SMTP sessions which are reused
+*			   between messages sent to the same mail server.
+*
+* Date: 17/10/2026
+*
+*/
+
+
+#include "SmtpConnectionPool.h"
+
+namespace FBMailUDF
+{
+	SmtpConnectionPool::SmtpConnectionPool()
+	{
+	}
+
+	SmtpConnectionPool::~SmtpConnectionPool()
+	{
+		clear();
+	}
+
+	CSmtp* SmtpConnectionPool::acquire(const MailServerHandle &server)
+	{
+		CSmtp *Result = nullptr;
+		std::vector<CSmtp*> expired;
+
+		{
+			std::lock_guard<std::mutex> guard(poolLock);
+			removeExpired(expired);
+
+			// most recently used sessions are at the end of the list
+			for (size_t i = idleConnections.size(); i > 0; i--)
+			{
+				if (*idleConnections.at(i - 1).server == *server)
+				{
+					Result = idleConnections.at(i - 1).connection;
+					idleConnections.erase(idleConnections.cbegin() + (i - 1));
+					break;
+				}
+			}
+		}
+
+		closeConnections(expired);
+
+		if (Result != nullptr)
+		{
+			// RSET clears any previous transaction and confirms the server has 
+			// not dropped the session whilst it was idle
+			try
+			{
+				Result->Reset();
+				return (Result);
+			}
+			catch (const ECSmtp &)
+			{
+				delete Result;
+			}
+		}
+
+		Result = new CSmtp();
+
+		try
+		{
+			Result->SetSMTPServer(server->getServerName().c_str(), server->getPortNumber());
+			Result->SetSecurityType(server->getSecurityType());
+			Result->SetLogin(server->getUserName().c_str());
+			Result->SetPassword(server->getUserPassword().c_str());
+			Result->SetAttachmentCache(&attachmentCache);
+		}
+		catch (...)
+		{
+			delete Result;
+			throw;
+		}
+
+		return (Result);
+	}
+
+	void SmtpConnectionPool::release(const MailServerHandle &server, CSmtp *connection)
+	{
+		if (connection == nullptr)
+			return;
+
+		std::vector<CSmtp*> expired;
+
+		// sessions which have failed are closed and never returned to the pool
+		if (connection->IsConnected())
+		{
+			connection->ClearMessage();
+
+			std::lock_guard<std::mutex> guard(poolLock);
+			removeExpired(expired);
+
+			int idleCount = 0;
+
+			for (size_t i = 0; i < idleConnections.size(); i++)
+			{
+				if (*idleConnections.at(i).server == *server)
+					idleCount++;
+			}
+
+			if (idleCount < SMTP_POOL_MAX_IDLE)
+			{
+				PooledConnection pooled;
+				pooled.server = server;
+				pooled.connection = connection;
+				time(&pooled.lastUsed);
+
+				idleConnections.push_back(pooled);
+				connection = nullptr;
+			}
+		}
+
+		if (connection != nullptr)
+			expired.push_back(connection);
+
+		closeConnections(expired);
+	}
+
+	void SmtpConnectionPool::evictIdle()
+	{
+		std::vector<CSmtp*> expired;
+
+		{
+			std::lock_guard<std::mutex> guard(poolLock);
+			removeExpired(expired);
+		}
+
+		closeConnections(expired);
+	}
+
+	void SmtpConnectionPool::clear()
+	{
+		std::vector<CSmtp*> connections;
+
+		{
+			std::lock_guard<std::mutex> guard(poolLock);
+
+			for (size_t i = 0; i < idleConnections.size(); i++)
+				connections.push_back(idleConnections.at(i).connection);
+
+			idleConnections.clear();
+		}
+
+		closeConnections(connections);
+	}
+
+	// private methods
+
+	void SmtpConnectionPool::removeExpired(std::vector<CSmtp*> &expired)
+	{
+		time_t currentTime;
+		time(&currentTime);
+
+		for (size_t i = idleConnections.size(); i > 0; i--)
+		{
+			if (difftime(currentTime, idleConnections.at(i - 1).lastUsed) > SMTP_POOL_IDLE_TIMEOUT)
+			{
+				expired.push_back(idleConnections.at(i - 1).connection);
+				idleConnections.erase(idleConnections.cbegin() + (i - 1));
+			}
+		}
+	}
+
+	void SmtpConnectionPool::closeConnections(std::vector<CSmtp*> &connections)
+	{
+		// closing a session sends QUIT, this is done outside of the pool lock
+		for (size_t i = 0; i < connections.size(); i++)
+			delete connections.at(i);
+
+		connections.clear();
+	}
+}
@@ -0,0 +1,82 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+* MIT License
+*
+* Copyright (c) 2017 Simon Carter (s1cart3r@gmail.com)
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*
+* The Original Code was created by Simon Carter (s1cart3r@gmail.com).
+*
+* Module:  fbSMTPUDF - Firebird UDF Library for sending emails.
+*
+* Description: Pool of open, authenticated SMTP sessions which are reused
+*			   between messages sent to the same mail server.
+*
+* Date: 17/10/2026
+*
+*/
+
+
+#ifndef FB_SMTP__CONNECTION_POOL
+#define FB_SMTP__CONNECTION_POOL
+
+#include <mutex>
+
+#include "Global.h"
+#include "CSmtp.h"
+#include "MailServer.h"
+#include "AttachmentCache.h"
+
+namespace FBMailUDF
+{
+	struct PooledConnection
+	{
+		MailServerHandle server;
+		CSmtp *connection;
+		time_t lastUsed;
+	};
+
+	typedef std::vector<PooledConnection> PooledConnectionList;
+
+	class SmtpConnectionPool
+	{
+	private:
+		PooledConnectionList idleConnections;
+		std::mutex poolLock;
+		AttachmentCache attachmentCache;
+
+		void removeExpired(std::vector<CSmtp*> &expired);
+		void closeConnections(std::vector<CSmtp*> &connections);
+
+		// prevent class copying
+		SmtpConnectionPool(const SmtpConnectionPool&);
+		SmtpConnectionPool& operator=(const SmtpConnectionPool&);
+	public:
+		SmtpConnectionPool();
+		~SmtpConnectionPool();
+
+		CSmtp* acquire(const MailServerHandle &server);
+		void release(const MailServerHandle &server, CSmtp *connection);
+
+		void evictIdle();
+		void clear();
+	};
+}
+
+#endif
@@ -0,0 +1,130 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+* MIT License
+*
+* Copyright (c) 2017 Simon Carter (s1cart3r@gmail.com)
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*
+* The Original Code was created by Simon Carter (s1cart3r@gmail.com).
+*
+* Module:  fbSMTPUDF - Firebird UDF Library for sending emails.
+*
+* Description: Unit tests for the cache of encoded attachments shared by the sessions.
+*
+* Date: 17/10/2026
+*
+*/
+
+
+#include "TestFramework.h"
+#include "AttachmentCache.h"
+
+using namespace FBMailUDF;
+
+const size_t CACHE_ENTRY_SIZE = 250000;		// four entries fit in a 1 MB cache
+
+static EncodedAttachment encodedFile(const char fill)
+{
+	return (std::make_shared<const std::string>(CACHE_ENTRY_SIZE, fill));
+}
+
+// every instance shares the one cache, each test starts with it empty
+static void emptyCache(const int size)
+{
+	AttachmentCache::setCacheSize(0);
+	AttachmentCache::setCacheSize(size);
+}
+
+TEST_CASE(cacheFindsAddedAttachment)
+{
+	AttachmentCache cache;
+	emptyCache(1);
+
+	EncodedAttachment encoded = encodedFile('a');
+	FB_BIGINT hits = AttachmentCache::getHits();
+	FB_BIGINT misses = AttachmentCache::getMisses();
+
+	CHECK(cache.Find("a.pdf") == nullptr);
+	cache.Add("a.pdf", encoded);
+
+	// the encoded file is shared, not copied
+	CHECK(cache.Find("a.pdf") == encoded);
+	CHECK_EQUAL(hits + 1, AttachmentCache::getHits());
+	CHECK_EQUAL(misses + 1, AttachmentCache::getMisses());
+
+	emptyCache(DEFAULT_ATTACHMENT_CACHE_SIZE);
+}
+
+TEST_CASE(cacheRemovesLeastRecentlySent)
+{
+	AttachmentCache cache;
+	emptyCache(1);
+
+	cache.Add("a.pdf", encodedFile('a'));
+	cache.Add("b.pdf", encodedFile('b'));
+	cache.Add("c.pdf", encodedFile('c'));
+	cache.Add("d.pdf", encodedFile('d'));
+
+	// sending a.pdf again makes b.pdf the least recently sent
+	CHECK(cache.Find("a.pdf") != nullptr);
+	cache.Add("e.pdf", encodedFile('e'));
+
+	CHECK(cache.Find("b.pdf") == nullptr);
+	CHECK(cache.Find("a.pdf") != nullptr);
+	CHECK(cache.Find("c.pdf") != nullptr);
+	CHECK(cache.Find("d.pdf") != nullptr);
+	CHECK(cache.Find("e.pdf") != nullptr);
+
+	emptyCache(DEFAULT_ATTACHMENT_CACHE_SIZE);
+}
+
+TEST_CASE(cacheTrimmedWhenSizeReduced)
+{
+	AttachmentCache cache;
+	emptyCache(1);
+
+	EncodedAttachment encoded = encodedFile('a');
+	cache.Add("a.pdf", encoded);
+
+	// a disabled cache finds nothing, and what it held is released
+	CHECK_EQUAL(EMailResult::Success, AttachmentCache::setCacheSize(0));
+	CHECK(cache.Find("a.pdf") == nullptr);
+	CHECK(!cache.CanCache(1));
+	CHECK(encoded.use_count() == 1);
+
+	CHECK_EQUAL(EMailResult::Success, AttachmentCache::setCacheSize(1));
+	CHECK(cache.Find("a.pdf") == nullptr);
+
+	emptyCache(DEFAULT_ATTACHMENT_CACHE_SIZE);
+}
+
+TEST_CASE(cacheRefusesLargeAttachments)
+{
+	AttachmentCache cache;
+	emptyCache(1);
+
+	// a file over a quarter of the cache is encoded as it is sent
+	CHECK(cache.CanCache(1024 * 1024 / 4));
+	CHECK(!cache.CanCache(1024 * 1024 / 4 + 1));
+
+	CHECK_EQUAL(EMailResult::InvalidOptionValue, AttachmentCache::setCacheSize(-1));
+	CHECK_EQUAL(EMailResult::InvalidOptionValue, AttachmentCache::setCacheSize(MAX_ATTACHMENT_CACHE_SIZE + 1));
+
+	emptyCache(DEFAULT_ATTACHMENT_CACHE_SIZE);
+}
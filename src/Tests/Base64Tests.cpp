@@ -0,0 +1,165 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+* MIT License
+*
+* Copyright (c) 2017 Simon Carter (s1cart3r@gmail.com)
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*
+* The Original Code was created by Simon Carter (s1cart3r@gmail.com).
+*
+* Module:  fbSMTPUDF - Firebird UDF Library for sending emails.
+*
+* Description: Unit tests for base64 encoding, decoding and encoded sizes.
+*
+* Date: 17/10/2026
+*
+*/
+
+
+#include <string>
+#include <random>
+
+#include "TestFramework.h"
+#include "base64.h"
+
+static std::string encode(const std::string &text, const size_t lineLength)
+{
+	std::string Result(base64_encoded_size(text.size(), lineLength), '\0');
+	size_t written = base64_encode_to(reinterpret_cast<const unsigned char*>(text.data()), text.size(), 
+		&Result[0], lineLength);
+	CHECK_EQUAL(Result.size(), written);
+	return (Result);
+}
+
+// a byte at a time encoder to compare the vector encoders with
+static std::string referenceEncode(const std::string &text, const size_t lineLength)
+{
+	static const char alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+	std::string encoded;
+
+	for (size_t i = 0; i < text.size(); i += 3)
+	{
+		unsigned int group = static_cast<unsigned char>(text[i]) << 16;
+
+		if (i + 1 < text.size())
+			group |= static_cast<unsigned char>(text[i + 1]) << 8;
+
+		if (i + 2 < text.size())
+			group |= static_cast<unsigned char>(text[i + 2]);
+
+		encoded += alphabet[(group >> 18) & 0x3f];
+		encoded += alphabet[(group >> 12) & 0x3f];
+		encoded += i + 1 < text.size() ? alphabet[(group >> 6) & 0x3f] : '=';
+		encoded += i + 2 < text.size() ? alphabet[group & 0x3f] : '=';
+	}
+
+	if (lineLength == 0)
+		return (encoded);
+
+	std::string Result;
+
+	for (size_t i = 0; i < encoded.size(); i += lineLength)
+		Result += encoded.substr(i, lineLength) + "\r\n";
+
+	return (Result);
+}
+
+TEST_CASE(base64KnownValues)
+{
+	// RFC 4648 section 10
+	CHECK_EQUAL(std::string(""), encode("", 0));
+	CHECK_EQUAL(std::string("Zg=="), encode("f", 0));
+	CHECK_EQUAL(std::string("Zm8="), encode("fo", 0));
+	CHECK_EQUAL(std::string("Zm9v"), encode("foo", 0));
+	CHECK_EQUAL(std::string("Zm9vYg=="), encode("foob", 0));
+	CHECK_EQUAL(std::string("Zm9vYmE="), encode("fooba", 0));
+	CHECK_EQUAL(std::string("Zm9vYmFy"), encode("foobar", 0));
+
+	CHECK_EQUAL(std::string("Zm9vYmFy"), base64_encode(reinterpret_cast<const unsigned char*>("foobar"), 6));
+}
+
+TEST_CASE(base64EncodedSize)
+{
+	CHECK_EQUAL(0u, base64_encoded_size(0, BASE64_MIME_LINE_LENGTH));
+	CHECK_EQUAL(4u, base64_encoded_size(1, 0));
+	CHECK_EQUAL(8u, base64_encoded_size(6, 0));
+
+	// 57 bytes fill a 76 character line, every line ends with CRLF
+	CHECK_EQUAL(78u, base64_encoded_size(57, BASE64_MIME_LINE_LENGTH));
+	CHECK_EQUAL(84u, base64_encoded_size(58, BASE64_MIME_LINE_LENGTH));
+	CHECK_EQUAL(1024u * 78u, base64_encoded_size(1024 * 57, BASE64_MIME_LINE_LENGTH));
+
+	// a line length which is not a multiple of 4 is rounded down
+	CHECK_EQUAL(base64_encoded_size(100, 76), base64_encoded_size(100, 78));
+}
+
+TEST_CASE(base64MimeLines)
+{
+	std::string text(120, 'z');
+	std::string encoded = encode(text, BASE64_MIME_LINE_LENGTH);
+
+	CHECK_EQUAL(std::string("\r\n"), encoded.substr(76, 2));
+	CHECK_EQUAL(std::string("\r\n"), encoded.substr(154, 2));
+	CHECK_EQUAL(std::string("\r\n"), encoded.substr(encoded.size() - 2));
+	CHECK_EQUAL(referenceEncode(text, BASE64_MIME_LINE_LENGTH), encoded);
+}
+
+TEST_CASE(base64MatchesReference)
+{
+	// every length up to a few vector blocks, so each encoder and its tail is used
+	std::mt19937 generator(7);
+	std::uniform_int_distribution<int> byte(0, 255);
+
+	for (size_t length = 0; length < 400; length++)
+	{
+		std::string text(length, '\0');
+
+		for (char &c : text)
+			c = static_cast<char>(byte(generator));
+
+		CHECK(referenceEncode(text, 0) == encode(text, 0));
+		CHECK(referenceEncode(text, BASE64_MIME_LINE_LENGTH) == encode(text, BASE64_MIME_LINE_LENGTH));
+		CHECK(text == base64_decode(encode(text, 0)));
+	}
+}
+
+TEST_CASE(base64BlocksJoinUp)
+{
+	// attachments are encoded a block of whole lines at a time, the blocks joined 
+	// together are the same as the whole file encoded at once
+	std::string text(57 * 10 + 20, '\0');
+
+	for (size_t i = 0; i < text.size(); i++)
+		text[i] = static_cast<char>(i * 31);
+
+	std::string blocks;
+
+	for (size_t i = 0; i < text.size(); i += 57 * 3)
+		blocks += encode(text.substr(i, 57 * 3), BASE64_MIME_LINE_LENGTH);
+
+	CHECK_EQUAL(encode(text, BASE64_MIME_LINE_LENGTH), blocks);
+}
+
+TEST_CASE(base64DecodeStopsAtInvalid)
+{
+	CHECK_EQUAL(std::string("foob"), base64_decode("Zm9vYg=="));
+	CHECK_EQUAL(std::string("fo"), base64_decode("Zm8"));
+	CHECK_EQUAL(std::string("foo"), base64_decode("Zm9v!Zm9v"));
+	CHECK_EQUAL(std::string(""), base64_decode(""));
+}
@@ -0,0 +1,170 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+* MIT License
+*
+* Copyright (c) 2017 Simon Carter (s1cart3r@gmail.com)
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*
+* The Original Code was created by Simon Carter (s1cart3r@gmail.com).
+*
+* Module:  fbSMTPUDF - Firebird UDF Library for sending emails.
+*
+* Description: Unit tests for line ending, dot stuffing and line wrapping of message bodies.
+*
+* Date: 17/10/2026
+*
+*/
+
+
+#include <random>
+
+#include "TestFramework.h"
+#include "BodyNormaliser.h"
+
+using namespace FBMailUDF;
+
+static std::string normalise(const std::string &body)
+{
+	std::string Result;
+	BodyNormaliser::normalise(body.data(), body.size(), Result);
+	return (Result);
+}
+
+// a byte at a time version of the rules, the normaliser should give the same output
+// whichever way it finds line breaks
+static std::string referenceNormalise(const std::string &body)
+{
+	std::string Result;
+	size_t lineLength = 0;
+
+	for (size_t i = 0; i < body.size(); i++)
+	{
+		if (body[i] == '\r' || body[i] == '\n')
+		{
+			if (body[i] == '\r' && i + 1 < body.size() && body[i + 1] == '\n')
+				i++;
+
+			Result += "\r\n";
+			lineLength = 0;
+			continue;
+		}
+
+		if (lineLength == 998)
+		{
+			Result += "\r\n";
+			lineLength = 0;
+		}
+
+		if (lineLength == 0 && body[i] == '.')
+		{
+			Result += '.';
+			lineLength++;
+		}
+
+		Result += body[i];
+		lineLength++;
+	}
+
+	if (lineLength > 0 || Result.empty())
+		Result += "\r\n";
+
+	return (Result);
+}
+
+TEST_CASE(normaliseLineEndings)
+{
+	CHECK_EQUAL(std::string("a\r\nb\r\n"), normalise("a\r\nb"));
+	CHECK_EQUAL(std::string("a\r\nb\r\n"), normalise("a\nb"));
+	CHECK_EQUAL(std::string("a\r\nb\r\n"), normalise("a\rb"));
+	CHECK_EQUAL(std::string("a\r\n\r\nb\r\n"), normalise("a\n\rb"));
+	CHECK_EQUAL(std::string("a\r\n\r\n"), normalise("a\r\n\r\n"));
+}
+
+TEST_CASE(normaliseEndsWithLineBreak)
+{
+	CHECK_EQUAL(std::string("\r\n"), normalise(""));
+	CHECK_EQUAL(std::string("text\r\n"), normalise("text"));
+	CHECK_EQUAL(std::string("text\r\n"), normalise("text\r\n"));
+}
+
+TEST_CASE(normaliseDotStuffing)
+{
+	CHECK_EQUAL(std::string("..\r\n"), normalise("."));
+	CHECK_EQUAL(std::string("a\r\n..\r\nb\r\n"), normalise("a\n.\nb"));
+	CHECK_EQUAL(std::string("..hidden\r\n...\r\n"), normalise(".hidden\r\n.."));
+
+	// only a dot at the start of a line is stuffed
+	CHECK_EQUAL(std::string("a.b.\r\n"), normalise("a.b."));
+}
+
+TEST_CASE(normaliseWrapsLongLines)
+{
+	std::string line(998, 'x');
+
+	CHECK_EQUAL(line + "\r\n", normalise(line));
+	CHECK_EQUAL(line + "\r\nx\r\n", normalise(line + "x"));
+	CHECK_EQUAL(line + "\r\n" + line + "\r\n" + "xx\r\n", normalise(line + line + "xx"));
+
+	// the line break after a full line is not doubled
+	CHECK_EQUAL(line + "\r\ny\r\n", normalise(line + "\ny"));
+}
+
+TEST_CASE(normaliseStuffedDotCountsTowardsLineLength)
+{
+	// the added dot takes the place of the last character on the line
+	std::string line = "." + std::string(997, 'x');
+
+	CHECK_EQUAL(".." + std::string(996, 'x') + "\r\nxx\r\n", normalise(line + "x"));
+
+	// a wrapped line which starts with a dot is stuffed as well
+	std::string wrapped = std::string(998, 'x') + ".y";
+	CHECK_EQUAL(std::string(998, 'x') + "\r\n..y\r\n", normalise(wrapped));
+}
+
+TEST_CASE(normaliseMatchesReference)
+{
+	// line breaks and dots at every offset within and across the 16 and 32 byte 
+	// blocks searched at a time
+	std::mt19937 generator(42);
+	std::uniform_int_distribution<int> pick(0, 99);
+	std::uniform_int_distribution<int> length(0, 3000);
+
+	for (int i = 0; i < 500; i++)
+	{
+		std::string body(length(generator), 'a');
+
+		for (char &c : body)
+		{
+			int p = pick(generator);
+
+			if (p < 3)
+				c = '\r';
+			else if (p < 6)
+				c = '\n';
+			else if (p < 9)
+				c = '.';
+		}
+
+		// some bodies have lines long enough to be wrapped
+		if (i % 4 == 0)
+			body.insert(body.size() / 2, std::string(2500, 'b'));
+
+		CHECK(referenceNormalise(body) == normalise(body));
+	}
+}
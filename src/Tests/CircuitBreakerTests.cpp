@@ -0,0 +1,169 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+* MIT License
+*
+* Copyright (c) 2017 Simon Carter (s1cart3r@gmail.com)
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*
+* The Original Code was created by Simon Carter (s1cart3r@gmail.com).
+*
+* Module:  fbSMTPUDF - Firebird UDF Library for sending emails.
+*
+* Description: Unit tests for the per server circuit breaker.
+*
+* Date: 17/10/2026
+*
+*/
+
+
+#include <thread>
+
+#include "TestFramework.h"
+#include "CircuitBreaker.h"
+
+using namespace FBMailUDF;
+
+TEST_CASE(breakerStartsClosed)
+{
+	CircuitBreaker breaker;
+	bool probe = true;
+	std::chrono::steady_clock::time_point available;
+
+	CHECK(breaker.isClosed());
+	CHECK(breaker.allowRequest(probe, available));
+	CHECK(!probe);
+}
+
+TEST_CASE(breakerOpensAfterConsecutiveFailures)
+{
+	CircuitBreaker breaker;
+	bool probe;
+	std::chrono::steady_clock::time_point available;
+
+	CHECK_EQUAL(EMailResult::Success, breaker.setFailureThreshold(3));
+
+	breaker.recordFailure();
+	breaker.recordFailure();
+	CHECK(breaker.isClosed());
+
+	// a success in between starts the count again
+	breaker.recordSuccess();
+	breaker.recordFailure();
+	breaker.recordFailure();
+	CHECK(breaker.isClosed());
+
+	breaker.recordFailure();
+	CHECK_EQUAL(CircuitState::Open, breaker.getState());
+
+	std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+	CHECK(!breaker.allowRequest(probe, available));
+	CHECK(available > now);
+	CHECK(available <= now + std::chrono::seconds(DEFAULT_BREAKER_PROBE_INTERVAL));
+}
+
+TEST_CASE(breakerProbeClosesOnSuccess)
+{
+	CircuitBreaker breaker;
+	bool probe;
+	std::chrono::steady_clock::time_point available;
+
+	CHECK_EQUAL(EMailResult::Success, breaker.setFailureThreshold(1));
+	CHECK_EQUAL(EMailResult::Success, breaker.setProbeInterval(1));
+
+	breaker.recordFailure();
+	CHECK(!breaker.allowRequest(probe, available));
+
+	std::this_thread::sleep_for(std::chrono::milliseconds(1100));
+
+	// one probe is let through, nothing else until it has finished
+	CHECK(breaker.allowRequest(probe, available));
+	CHECK(probe);
+	CHECK_EQUAL(CircuitState::HalfOpen, breaker.getState());
+	CHECK(!breaker.allowRequest(probe, available));
+	CHECK(!probe);
+
+	breaker.recordSuccess();
+	CHECK(breaker.isClosed());
+	CHECK(breaker.allowRequest(probe, available));
+}
+
+TEST_CASE(breakerProbeReopensOnFailure)
+{
+	CircuitBreaker breaker;
+	bool probe;
+	std::chrono::steady_clock::time_point available;
+
+	CHECK_EQUAL(EMailResult::Success, breaker.setFailureThreshold(5));
+	CHECK_EQUAL(EMailResult::Success, breaker.setProbeInterval(1));
+
+	for (int i = 0; i < 5; i++)
+		breaker.recordFailure();
+
+	std::this_thread::sleep_for(std::chrono::milliseconds(1100));
+
+	CHECK(breaker.allowRequest(probe, available));
+	CHECK(probe);
+
+	// a failed probe opens the circuit again straight away, not after the threshold
+	breaker.recordFailure();
+	CHECK_EQUAL(CircuitState::Open, breaker.getState());
+	CHECK(!breaker.allowRequest(probe, available));
+}
+
+TEST_CASE(breakerCancelledProbeCanBeRetried)
+{
+	CircuitBreaker breaker;
+	bool probe;
+	std::chrono::steady_clock::time_point available;
+
+	CHECK_EQUAL(EMailResult::Success, breaker.setFailureThreshold(1));
+	CHECK_EQUAL(EMailResult::Success, breaker.setProbeInterval(1));
+
+	breaker.recordFailure();
+	std::this_thread::sleep_for(std::chrono::milliseconds(1100));
+
+	CHECK(breaker.allowRequest(probe, available));
+	breaker.probeCancelled();
+	CHECK_EQUAL(CircuitState::Open, breaker.getState());
+
+	CHECK(breaker.allowRequest(probe, available));
+	CHECK(probe);
+}
+
+TEST_CASE(breakerConnectionFailures)
+{
+	CHECK(CircuitBreaker::isConnectionFailure(ECSmtp(ECSmtp::WSA_CONNECT)));
+	CHECK(CircuitBreaker::isConnectionFailure(ECSmtp(ECSmtp::SELECT_TIMEOUT)));
+	CHECK(CircuitBreaker::isConnectionFailure(ECSmtp(ECSmtp::SSL_PROBLEM)));
+
+	// any reply shows the server can be reached
+	CHECK(!CircuitBreaker::isConnectionFailure(ECSmtp(ECSmtp::SERVER_NOT_READY, 421)));
+	CHECK(!CircuitBreaker::isConnectionFailure(ECSmtp(ECSmtp::COMMAND_RCPT_TO, 550)));
+	CHECK(!CircuitBreaker::isConnectionFailure(ECSmtp(ECSmtp::FILE_NOT_EXIST)));
+}
+
+TEST_CASE(breakerInvalidOptions)
+{
+	CircuitBreaker breaker;
+
+	CHECK_EQUAL(EMailResult::InvalidOptionValue, breaker.setFailureThreshold(0));
+	CHECK_EQUAL(EMailResult::InvalidOptionValue, breaker.setFailureThreshold(MAX_BREAKER_FAILURES + 1));
+	CHECK_EQUAL(EMailResult::InvalidOptionValue, breaker.setProbeInterval(0));
+	CHECK_EQUAL(EMailResult::InvalidOptionValue, breaker.setProbeInterval(MAX_BREAKER_PROBE_INTERVAL + 1));
+}
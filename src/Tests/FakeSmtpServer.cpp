@@ -0,0 +1,285 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+* MIT License
+*
+* Copyright (c) 2017 Simon Carter (s1cart3r@gmail.com)
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*
+* The Original Code was created by Simon Carter (s1cart3r@gmail.com).
+*
+* Module:  fbSMTPUDF - Firebird UDF Library for sending emails.
+*
+* Description: Scripted SMTP server the session tests connect to on the local host.
+*
+* Date: 17/10/2026
+*
+*/
+
+
+#include <algorithm>
+#include <cctype>
+
+#include "FakeSmtpServer.h"
+
+#ifdef LINUX
+	#define closesocket close
+#endif
+
+namespace FBMailUDFTests
+{
+	FakeSmtpServer::FakeSmtpServer(const bool supportPipelining)
+		: listenSocket(INVALID_SOCKET), port(0), pipelining(supportPipelining), closeAfterMessage(false),
+		dataReply("354 Start mail input"), connections(0), messages(0), acceptedRecipients(0), 
+		stopping(false)
+	{
+#ifndef LINUX
+		WSADATA wsaData;
+		WSAStartup(MAKEWORD(2, 2), &wsaData);
+#endif
+		listenSocket = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+
+		SOCKADDR_IN address;
+		memset(&address, 0, sizeof(address));
+		address.sin_family = AF_INET;
+		address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+		address.sin_port = 0;
+
+		// the system chooses a free port
+		bind(listenSocket, reinterpret_cast<LPSOCKADDR>(&address), sizeof(address));
+		listen(listenSocket, 1);
+
+#ifdef LINUX
+		socklen_t length = sizeof(address);
+#else
+		int length = sizeof(address);
+#endif
+		getsockname(listenSocket, reinterpret_cast<LPSOCKADDR>(&address), &length);
+		port = ntohs(address.sin_port);
+
+		serverThread = std::thread(&FakeSmtpServer::run, this);
+	}
+
+	FakeSmtpServer::~FakeSmtpServer()
+	{
+		stopping = true;
+		serverThread.join();
+		closesocket(listenSocket);
+#ifndef LINUX
+		WSACleanup();
+#endif
+	}
+
+	unsigned short FakeSmtpServer::getPort() const
+	{
+		return (port);
+	}
+
+	void FakeSmtpServer::rejectRecipient(const std::string &address)
+	{
+		std::lock_guard<std::mutex> guard(stateLock);
+		rejectedRecipients.insert(address);
+	}
+
+	void FakeSmtpServer::setDataReply(const std::string &reply)
+	{
+		std::lock_guard<std::mutex> guard(stateLock);
+		dataReply = reply;
+	}
+
+	void FakeSmtpServer::setCloseAfterMessage(const bool value)
+	{
+		std::lock_guard<std::mutex> guard(stateLock);
+		closeAfterMessage = value;
+	}
+
+	int FakeSmtpServer::getConnectionCount()
+	{
+		std::lock_guard<std::mutex> guard(stateLock);
+		return (connections);
+	}
+
+	int FakeSmtpServer::getMessageCount()
+	{
+		std::lock_guard<std::mutex> guard(stateLock);
+		return (messages);
+	}
+
+	int FakeSmtpServer::getCommandCount(const std::string &verb)
+	{
+		std::lock_guard<std::mutex> guard(stateLock);
+		int Result = 0;
+
+		for (size_t i = 0; i < commands.size(); i++)
+			if (commands.at(i).compare(0, verb.size(), verb) == 0)
+				Result++;
+
+		return (Result);
+	}
+
+	// private methods
+
+	void FakeSmtpServer::run()
+	{
+		while (!stopping)
+		{
+			fd_set readable;
+			FD_ZERO(&readable);
+			FD_SET(listenSocket, &readable);
+			timeval wait = { 0, 50000 };
+
+			// the socket is polled so the server notices when it is asked to stop
+			if (select(static_cast<int>(listenSocket) + 1, &readable, NULL, NULL, &wait) <= 0)
+				continue;
+
+			SOCKET client = accept(listenSocket, NULL, NULL);
+
+			if (client == INVALID_SOCKET)
+				continue;
+
+			{
+				std::lock_guard<std::mutex> guard(stateLock);
+				connections++;
+			}
+
+			serveSession(client);
+			closesocket(client);
+		}
+	}
+
+	void FakeSmtpServer::serveSession(SOCKET client)
+	{
+		std::string received;
+		bool inData = false;
+		bool quit = false;
+		char buffer[4096];
+
+		if (!reply(client, "220 localhost ready\r\n"))
+			return;
+
+		while (!stopping && !quit)
+		{
+			fd_set readable;
+			FD_ZERO(&readable);
+			FD_SET(client, &readable);
+			timeval wait = { 0, 50000 };
+
+			if (select(static_cast<int>(client) + 1, &readable, NULL, NULL, &wait) <= 0)
+				continue;
+
+			int count = recv(client, buffer, sizeof(buffer), 0);
+
+			if (count <= 0)
+				return;
+
+			received.append(buffer, count);
+
+			// pipelined commands arrive together, each is answered in turn
+			size_t end;
+
+			while (!quit && (end = received.find("\r\n")) != std::string::npos)
+			{
+				std::string line = received.substr(0, end);
+				received.erase(0, end + 2);
+
+				if (inData)
+				{
+					if (line.compare(".") != 0)
+						continue;
+
+					inData = false;
+					bool accepted;
+					bool dropSession;
+
+					{
+						std::lock_guard<std::mutex> guard(stateLock);
+						accepted = acceptedRecipients > 0;
+						dropSession = closeAfterMessage;
+
+						if (accepted)
+							messages++;
+					}
+
+					// a message is only delivered if at least one recipient was accepted
+					if (!accepted)
+					{
+						if (!reply(client, "554 No valid recipients\r\n"))
+							return;
+
+						continue;
+					}
+
+					if (!reply(client, "250 Message accepted\r\n") || dropSession)
+						return;
+
+					continue;
+				}
+
+				if (!reply(client, replyTo(line, inData, quit)))
+					return;
+			}
+		}
+	}
+
+	bool FakeSmtpServer::reply(SOCKET client, const std::string &text)
+	{
+		return (send(client, text.c_str(), static_cast<int>(text.size()), 0) == static_cast<int>(text.size()));
+	}
+
+	std::string FakeSmtpServer::replyTo(const std::string &command, bool &inData, bool &quit)
+	{
+		std::lock_guard<std::mutex> guard(stateLock);
+		std::string verb = command.substr(0, 4);
+		std::transform(verb.begin(), verb.end(), verb.begin(), ::toupper);
+		commands.push_back(verb);
+
+		if (verb == "EHLO")
+			return (pipelining ? "250-localhost\r\n250-PIPELINING\r\n250 8BITMIME\r\n" : "250-localhost\r\n250 8BITMIME\r\n");
+
+		if (verb == "RCPT")
+		{
+			size_t start = command.find('<');
+			size_t end = command.find('>');
+			std::string address = start == std::string::npos || end == std::string::npos ? "" : 
+				command.substr(start + 1, end - start - 1);
+
+			if (rejectedRecipients.find(address) != rejectedRecipients.end())
+				return ("550 Mailbox unavailable\r\n");
+
+			acceptedRecipients++;
+			return ("250 OK\r\n");
+		}
+
+		if (verb == "MAIL" || verb == "RSET")
+			acceptedRecipients = 0;
+
+		if (verb == "DATA")
+		{
+			inData = dataReply.compare(0, 3, "354") == 0;
+			return (dataReply + "\r\n");
+		}
+
+		if (verb == "QUIT")
+		{
+			quit = true;
+			return ("221 Bye\r\n");
+		}
+
+		return ("250 OK\r\n");
+	}
+}
@@ -0,0 +1,97 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+* MIT License
+*
+* Copyright (c) 2017 Simon Carter (s1cart3r@gmail.com)
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*
+* The Original Code was created by Simon Carter (s1cart3r@gmail.com).
+*
+* Module:  fbSMTPUDF - Firebird UDF Library for sending emails.
+*
+* Description: Scripted SMTP server the session tests connect to on the local host.
+*
+* Date: 17/10/2026
+*
+*/
+
+
+#ifndef FB_SMTP__FAKE_SMTP_SERVER
+#define FB_SMTP__FAKE_SMTP_SERVER
+
+#include <string>
+#include <vector>
+#include <set>
+#include <mutex>
+#include <thread>
+#include <atomic>
+
+#include "CSmtp.h"
+
+namespace FBMailUDFTests
+{
+	// accepts one session at a time, replies to each command as a server would and
+	// records the commands it was sent, messages are read and discarded
+	class FakeSmtpServer
+	{
+	private:
+		SOCKET listenSocket;
+		unsigned short port;
+		bool pipelining;
+		bool closeAfterMessage;
+		std::string dataReply;
+		std::set<std::string> rejectedRecipients;
+		std::vector<std::string> commands;
+		int connections;
+		int messages;
+		int acceptedRecipients;
+		std::mutex stateLock;
+		std::atomic<bool> stopping;
+		std::thread serverThread;
+
+		void run();
+		void serveSession(SOCKET client);
+		bool reply(SOCKET client, const std::string &text);
+		std::string replyTo(const std::string &command, bool &inData, bool &quit);
+
+		// prevent class copying
+		FakeSmtpServer(const FakeSmtpServer&);
+		FakeSmtpServer& operator=(const FakeSmtpServer&);
+	public:
+		FakeSmtpServer(const bool supportPipelining);
+		~FakeSmtpServer();
+
+		unsigned short getPort() const;
+
+		// recipients refused with 550, every other recipient is accepted
+		void rejectRecipient(const std::string &address);
+
+		// the reply to DATA, by default 354 whether or not a recipient was accepted
+		void setDataReply(const std::string &reply);
+
+		// the server drops the session after each message, as it would an idle session
+		void setCloseAfterMessage(const bool value);
+
+		int getConnectionCount();
+		int getMessageCount();
+		int getCommandCount(const std::string &verb);
+	};
+}
+
+#endif
@@ -0,0 +1,140 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+* MIT License
+*
+* Copyright (c) 2017 Simon Carter (s1cart3r@gmail.com)
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*
+* The Original Code was created by Simon Carter (s1cart3r@gmail.com).
+*
+* Module:  fbSMTPUDF - Firebird UDF Library for sending emails.
+*
+* Description: Unit tests for the store of send results bounded by age and capacity.
+*
+* Date: 17/10/2026
+*
+*/
+
+
+#include <thread>
+
+#include "TestFramework.h"
+#include "MailSendResultStore.h"
+
+using namespace FBMailUDF;
+
+static void addResult(MailSendResultStore &store, const FB_BIGINT messageID, const EMailResult value)
+{
+	MailSendResult result = MailSendResult(messageID, 1, value);
+	store.add(result);
+}
+
+static bool hasResult(MailSendResultStore &store, const FB_BIGINT messageID)
+{
+	std::string errorMessage;
+	int errorCode;
+
+	return (store.find(1, messageID, false, errorMessage, errorCode) != EMailResult::NotFound);
+}
+
+TEST_CASE(storeFindsAndErasesResult)
+{
+	MailSendResultStore store;
+	MailSendResult result = MailSendResult(10, 2, EMailResult::NotSent, "Mailbox unavailable", 550);
+	std::string errorMessage;
+	int errorCode = 0;
+
+	store.add(result);
+
+	CHECK_EQUAL(EMailResult::NotSent, store.find(2, 10, false, errorMessage, errorCode));
+	CHECK_EQUAL(std::string("Mailbox unavailable"), errorMessage);
+	CHECK_EQUAL(550, errorCode);
+
+	// results are keyed by server and message
+	CHECK_EQUAL(EMailResult::NotFound, store.find(1, 10, false, errorMessage, errorCode));
+
+	CHECK_EQUAL(EMailResult::NotSent, store.find(2, 10, true, errorMessage, errorCode));
+	CHECK_EQUAL(EMailResult::NotFound, store.find(2, 10, false, errorMessage, errorCode));
+	CHECK_EQUAL(0u, store.size());
+}
+
+TEST_CASE(storeKeepsLatestResultForMessage)
+{
+	MailSendResultStore store;
+	std::string errorMessage;
+	int errorCode;
+
+	addResult(store, 1, EMailResult::NotSent);
+	addResult(store, 1, EMailResult::Success);
+
+	CHECK_EQUAL(1u, store.size());
+	CHECK_EQUAL(EMailResult::Success, store.find(1, 1, false, errorMessage, errorCode));
+}
+
+TEST_CASE(storeRemovesOldestResultsOverCapacity)
+{
+	MailSendResultStore store(std::chrono::seconds(3600), 3);
+
+	for (FB_BIGINT i = 1; i <= 5; i++)
+		addResult(store, i, EMailResult::Success);
+
+	CHECK_EQUAL(3u, store.size());
+	CHECK(!hasResult(store, 1));
+	CHECK(!hasResult(store, 2));
+	CHECK(hasResult(store, 3));
+	CHECK(hasResult(store, 5));
+}
+
+TEST_CASE(storeReplacedResultIsNotRemovedByItsOldAge)
+{
+	MailSendResultStore store(std::chrono::seconds(3600), 3);
+
+	addResult(store, 1, EMailResult::Success);
+	addResult(store, 2, EMailResult::Success);
+	addResult(store, 3, EMailResult::Success);
+
+	// the result for message 1 is replaced, it is now newer than messages 2 and 3
+	addResult(store, 1, EMailResult::NotSent);
+	addResult(store, 4, EMailResult::Success);
+
+	CHECK_EQUAL(3u, store.size());
+	CHECK(hasResult(store, 1));
+	CHECK(!hasResult(store, 2));
+	CHECK(hasResult(store, 3));
+	CHECK(hasResult(store, 4));
+}
+
+TEST_CASE(storeRemovesExpiredResults)
+{
+	MailSendResultStore store(std::chrono::seconds(1), 100);
+
+	addResult(store, 1, EMailResult::Success);
+	addResult(store, 2, EMailResult::Success);
+	CHECK_EQUAL(2u, store.size());
+
+	std::this_thread::sleep_for(std::chrono::milliseconds(1100));
+
+	// expired results are removed as new results are added
+	addResult(store, 3, EMailResult::Success);
+
+	CHECK_EQUAL(1u, store.size());
+	CHECK(!hasResult(store, 1));
+	CHECK(!hasResult(store, 2));
+	CHECK(hasResult(store, 3));
+}
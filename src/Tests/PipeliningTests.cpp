@@ -0,0 +1,139 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+* MIT License
+*
+* Copyright (c) 2017 Simon Carter (s1cart3r@gmail.com)
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*
+* The Original Code was created by Simon Carter (s1cart3r@gmail.com).
+*
+* Module:  fbSMTPUDF - Firebird UDF Library for sending emails.
+*
+* Description: Unit tests for pipelined envelopes and the replies read for them.
+*
+* Date: 17/10/2026
+*
+*/
+
+
+#include "TestFramework.h"
+#include "FakeSmtpServer.h"
+#include "CSmtp.h"
+
+using namespace FBMailUDFTests;
+
+static void prepareMessage(CSmtp &mail, FakeSmtpServer &server)
+{
+	mail.SetSMTPServer("127.0.0.1", server.getPort(), false);
+	mail.SetSecurityType(NO_SECURITY);
+	mail.SetSenderMail("sender@example.com");
+	mail.SetSubject("pipelined envelope");
+	mail.AddMsgLine("message text");
+}
+
+TEST_CASE(pipeliningSendsWhenSomeRecipientsRejected)
+{
+	FakeSmtpServer server(true);
+	server.rejectRecipient("second@example.com");
+
+	CSmtp mail;
+	prepareMessage(mail, server);
+	mail.AddRecipient("first@example.com");
+	mail.AddRecipient("second@example.com");
+	mail.AddRecipient("third@example.com");
+
+	bool sent = true;
+
+	try
+	{
+		mail.Send();
+	}
+	catch (const ECSmtp &)
+	{
+		sent = false;
+	}
+
+	CHECK(sent);
+	CHECK(mail.IsPipeliningSupported());
+
+	// each RCPT reply is matched to its recipient, only the refused one is reported
+	CHECK_EQUAL(1u, mail.GetRejectedRecipientCount());
+	CHECK_EQUAL(std::string("second@example.com"), std::string(mail.GetRejectedRecipient(0)));
+	CHECK_EQUAL(1, server.getMessageCount());
+	CHECK_EQUAL(3, server.getCommandCount("RCPT"));
+
+	mail.DisconnectRemoteServer();
+}
+
+TEST_CASE(pipeliningFailsWhenEveryRecipientRejected)
+{
+	FakeSmtpServer server(true);
+	server.rejectRecipient("first@example.com");
+	server.rejectRecipient("second@example.com");
+
+	CSmtp mail;
+	prepareMessage(mail, server);
+	mail.AddRecipient("first@example.com");
+	mail.AddRecipient("second@example.com");
+
+	int error = ECSmtp::CSMTP_NO_ERROR;
+
+	try
+	{
+		mail.Send();
+	}
+	catch (const ECSmtp &e)
+	{
+		error = e.GetErrorNum();
+	}
+
+	CHECK_EQUAL(static_cast<int>(ECSmtp::COMMAND_RCPT_TO), error);
+	CHECK_EQUAL(2u, mail.GetRejectedRecipientCount());
+	CHECK_EQUAL(0, server.getMessageCount());
+
+	// the server accepted the pipelined DATA, the empty message is ended so that
+	// QUIT is read as a command and not as part of the message
+	CHECK_EQUAL(1, server.getCommandCount("DATA"));
+	CHECK_EQUAL(1, server.getCommandCount("QUIT"));
+}
+
+TEST_CASE(pipeliningFailsWhenDataRefused)
+{
+	FakeSmtpServer server(true);
+	server.setDataReply("554 Transaction failed");
+
+	CSmtp mail;
+	prepareMessage(mail, server);
+	mail.AddRecipient("first@example.com");
+
+	int error = ECSmtp::CSMTP_NO_ERROR;
+
+	try
+	{
+		mail.Send();
+	}
+	catch (const ECSmtp &e)
+	{
+		error = e.GetErrorNum();
+	}
+
+	CHECK_EQUAL(static_cast<int>(ECSmtp::COMMAND_DATA), error);
+	CHECK_EQUAL(0, server.getMessageCount());
+	CHECK_EQUAL(1, server.getCommandCount("QUIT"));
+}
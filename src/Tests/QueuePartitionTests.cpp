@@ -0,0 +1,185 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+* MIT License
+*
+* Copyright (c) 2017 Simon Carter (s1cart3r@gmail.com)
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*
+* The Original Code was created by Simon Carter (s1cart3r@gmail.com).
+*
+* Module:  fbSMTPUDF - Firebird UDF Library for sending emails.
+*
+* Description: Unit tests for the deficit round robin shared between database partitions.
+*
+* Date: 17/10/2026
+*
+*/
+
+
+#include "TestFramework.h"
+#include "QueuePartition.h"
+
+using namespace FBMailUDF;
+
+static MailServerHandle partitionServer()
+{
+	return (std::make_shared<const MailServer>(1, "127.0.0.1", 25, NO_SECURITY, "user", "password", "test.fdb"));
+}
+
+static void queueMessages(QueuePartition &partition, const MailServerHandle &server, const int count)
+{
+	for (int i = 0; i < count; i++)
+	{
+		partition.push(MailMessage(server, i + 1, "Sender", "sender@example.com", "Recipient", 
+			"recipient@example.com", "subject", "message text", 5));
+	}
+}
+
+// claims the next batch and releases the session it was claimed on, returns the
+// partition the batch was claimed from
+static QueuePartition* claimNext(std::vector<QueuePartition*> &partitions, std::atomic<size_t> &next,
+	size_t &claimed)
+{
+	MailServerHandle server;
+	MailMessageList batch;
+	std::chrono::steady_clock::time_point available = std::chrono::steady_clock::time_point::max();
+
+	QueuePartition *Result = QueuePartition::claimNextBatch(partitions, next, server, batch, available);
+	claimed = batch.size();
+
+	if (Result != nullptr)
+		server->getState()->releaseSession();
+
+	return (Result);
+}
+
+TEST_CASE(schedulerSharesSendingByWeight)
+{
+	MailServerHandle server = partitionServer();
+	QueuePartition first("first.fdb");
+	QueuePartition second("second.fdb");
+	std::vector<QueuePartition*> partitions = { &first, &second };
+	std::atomic<size_t> next(0);
+	size_t firstSent = 0;
+	size_t secondSent = 0;
+
+	CHECK_EQUAL(EMailResult::Success, second.setWeight(3));
+	queueMessages(first, server, 2000);
+	queueMessages(second, server, 2000);
+
+	// each round the first database sends its quantum and the second three times as many
+	for (int i = 0; i < 16; i++)
+	{
+		size_t claimed = 0;
+		QueuePartition *partition = claimNext(partitions, next, claimed);
+
+		CHECK(partition != nullptr);
+		CHECK(claimed <= MAX_MESSAGES_PER_SESSION);
+
+		if (partition == &first)
+			firstSent += claimed;
+		else if (partition == &second)
+			secondSent += claimed;
+	}
+
+	CHECK_EQUAL(static_cast<size_t>(4 * DATABASE_QUANTUM), firstSent);
+	CHECK_EQUAL(static_cast<size_t>(12 * DATABASE_QUANTUM), secondSent);
+}
+
+TEST_CASE(schedulerKeepsTurnUntilDeficitUsed)
+{
+	MailServerHandle server = partitionServer();
+	QueuePartition first("first.fdb");
+	QueuePartition second("second.fdb");
+	std::vector<QueuePartition*> partitions = { &first, &second };
+	std::atomic<size_t> next(0);
+	size_t claimed = 0;
+
+	CHECK_EQUAL(EMailResult::Success, first.setWeight(2));
+	queueMessages(first, server, 1000);
+	queueMessages(second, server, 1000);
+
+	CHECK(claimNext(partitions, next, claimed) == &first);
+	CHECK(claimNext(partitions, next, claimed) == &first);
+	CHECK(claimNext(partitions, next, claimed) == &second);
+	CHECK(claimNext(partitions, next, claimed) == &first);
+}
+
+TEST_CASE(schedulerIdleDatabaseDoesNotSaveUpShare)
+{
+	MailServerHandle server = partitionServer();
+	QueuePartition busy("busy.fdb");
+	QueuePartition idle("idle.fdb");
+	std::vector<QueuePartition*> partitions = { &busy, &idle };
+	std::atomic<size_t> next(0);
+	size_t claimed = 0;
+
+	queueMessages(busy, server, 3000);
+
+	for (int i = 0; i < 10; i++)
+		CHECK(claimNext(partitions, next, claimed) == &busy);
+
+	CHECK_EQUAL(0, idle.getDeficit());
+
+	// once the idle database queues messages it takes turns, it is not given the
+	// rounds it missed
+	queueMessages(idle, server, 1000);
+
+	size_t idleSent = 0;
+
+	for (int i = 0; i < 4; i++)
+	{
+		if (claimNext(partitions, next, claimed) == &idle)
+			idleSent += claimed;
+	}
+
+	CHECK_EQUAL(static_cast<size_t>(2 * DATABASE_QUANTUM), idleSent);
+}
+
+TEST_CASE(schedulerRefundsMessagesReturnedUnsent)
+{
+	MailServerHandle server = partitionServer();
+	QueuePartition partition("test.fdb");
+	std::vector<QueuePartition*> partitions = { &partition };
+	std::atomic<size_t> next(0);
+	MailServerHandle claimedServer;
+	MailMessageList batch;
+	std::chrono::steady_clock::time_point available = std::chrono::steady_clock::time_point::max();
+
+	queueMessages(partition, server, 500);
+
+	CHECK(QueuePartition::claimNextBatch(partitions, next, claimedServer, batch, available) == &partition);
+	CHECK_EQUAL(0, partition.getDeficit());
+
+	// none of the batch reached the server, the database is not charged for it
+	partition.returnUnsent(batch, 0);
+	claimedServer->getState()->releaseSession();
+
+	CHECK_EQUAL(DATABASE_QUANTUM, partition.getDeficit());
+	CHECK_EQUAL(500, partition.count());
+}
+
+TEST_CASE(schedulerWeightIsValidated)
+{
+	QueuePartition partition("test.fdb");
+
+	CHECK_EQUAL(EMailResult::InvalidOptionValue, partition.setWeight(0));
+	CHECK_EQUAL(EMailResult::InvalidOptionValue, partition.setWeight(MAX_DATABASE_WEIGHT + 1));
+	CHECK_EQUAL(EMailResult::Success, partition.setWeight(MAX_DATABASE_WEIGHT));
+}
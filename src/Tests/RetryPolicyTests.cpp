@@ -0,0 +1,105 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+* MIT License
+*
+* Copyright (c) 2017 Simon Carter (s1cart3r@gmail.com)
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*
+* The Original Code was created by Simon Carter (s1cart3r@gmail.com).
+*
+* Module:  fbSMTPUDF - Firebird UDF Library for sending emails.
+*
+* Description: Unit tests for retry classification and backoff.
+*
+* Date: 17/10/2026
+*
+*/
+
+
+#include "TestFramework.h"
+#include "RetryPolicy.h"
+
+using namespace FBMailUDF;
+
+TEST_CASE(retryTransientReplies)
+{
+	CHECK(RetryPolicy::isTransient(ECSmtp(ECSmtp::COMMAND_MAIL_FROM, 421)));
+	CHECK(RetryPolicy::isTransient(ECSmtp(ECSmtp::COMMAND_RCPT_TO, 450)));
+	CHECK(!RetryPolicy::isTransient(ECSmtp(ECSmtp::COMMAND_RCPT_TO, 550)));
+	CHECK(!RetryPolicy::isTransient(ECSmtp(ECSmtp::COMMAND_MAIL_FROM, 354)));
+}
+
+TEST_CASE(retryTransientConnectionErrors)
+{
+	CHECK(RetryPolicy::isTransient(ECSmtp(ECSmtp::WSA_CONNECT)));
+	CHECK(RetryPolicy::isTransient(ECSmtp(ECSmtp::CONNECTION_CLOSED)));
+	CHECK(RetryPolicy::isTransient(ECSmtp(ECSmtp::SELECT_TIMEOUT)));
+	CHECK(!RetryPolicy::isTransient(ECSmtp(ECSmtp::FILE_NOT_EXIST)));
+	CHECK(!RetryPolicy::isTransient(ECSmtp(ECSmtp::BAD_LOGIN_PASS)));
+	CHECK(!RetryPolicy::isTransient(ECSmtp(ECSmtp::MSG_TOO_BIG)));
+}
+
+TEST_CASE(retryLimit)
+{
+	CHECK_EQUAL(EMailResult::Success, RetryPolicy::setRetryLimit(2));
+	CHECK(RetryPolicy::canRetry(1));
+	CHECK(RetryPolicy::canRetry(2));
+	CHECK(!RetryPolicy::canRetry(3));
+
+	CHECK_EQUAL(EMailResult::Success, RetryPolicy::setRetryLimit(0));
+	CHECK(!RetryPolicy::canRetry(1));
+
+	CHECK_EQUAL(EMailResult::InvalidOptionValue, RetryPolicy::setRetryLimit(-1));
+	CHECK_EQUAL(EMailResult::InvalidOptionValue, RetryPolicy::setRetryLimit(MAX_RETRY_LIMIT + 1));
+
+	RetryPolicy::setRetryLimit(DEFAULT_RETRY_LIMIT);
+}
+
+TEST_CASE(retryBackoffDoublesWithJitter)
+{
+	CHECK_EQUAL(EMailResult::Success, RetryPolicy::setRetryDelay(10));
+
+	// each attempt is retried between half and all of the delay, which doubles
+	for (int i = 0; i < 100; i++)
+	{
+		time_t now = time(NULL);
+		time_t first = RetryPolicy::nextAttempt(1) - now;
+		time_t third = RetryPolicy::nextAttempt(3) - now;
+
+		CHECK(first >= 5 && first <= 11);
+		CHECK(third >= 20 && third <= 41);
+	}
+
+	RetryPolicy::setRetryDelay(DEFAULT_RETRY_DELAY);
+}
+
+TEST_CASE(retryBackoffIsCapped)
+{
+	CHECK_EQUAL(EMailResult::Success, RetryPolicy::setRetryDelay(MAX_RETRY_DELAY));
+
+	time_t now = time(NULL);
+	time_t delay = RetryPolicy::nextAttempt(1000) - now;
+
+	CHECK(delay >= MAX_RETRY_DELAY / 2 && delay <= MAX_RETRY_DELAY + 1);
+
+	CHECK_EQUAL(EMailResult::InvalidOptionValue, RetryPolicy::setRetryDelay(0));
+	CHECK_EQUAL(EMailResult::InvalidOptionValue, RetryPolicy::setRetryDelay(MAX_RETRY_DELAY + 1));
+
+	RetryPolicy::setRetryDelay(DEFAULT_RETRY_DELAY);
+}
@@ -0,0 +1,137 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+* MIT License
+*
+* Copyright (c) 2017 Simon Carter (s1cart3r@gmail.com)
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*
+* The Original Code was created by Simon Carter (s1cart3r@gmail.com).
+*
+* Module:  fbSMTPUDF - Firebird UDF Library for sending emails.
+*
+* Description: Unit tests for the per server token bucket and daily quota.
+*
+* Date: 17/10/2026
+*
+*/
+
+
+#include <thread>
+
+#include "TestFramework.h"
+#include "ServerRateLimit.h"
+
+using namespace FBMailUDF;
+
+TEST_CASE(rateLimitUnlimitedByDefault)
+{
+	ServerRateLimit limit;
+	std::chrono::steady_clock::time_point available;
+
+	CHECK_EQUAL(1000, limit.tryAcquire(1000, available));
+	CHECK_EQUAL(1000, limit.getSentToday());
+}
+
+TEST_CASE(rateLimitBurstIsTakenThenEmpty)
+{
+	ServerRateLimit limit;
+	std::chrono::steady_clock::time_point available;
+
+	CHECK_EQUAL(EMailResult::Success, limit.setRatePerMinute(60));
+	CHECK_EQUAL(DEFAULT_SERVER_RATE_BURST, limit.tryAcquire(DEFAULT_SERVER_RATE_BURST + 5, available));
+
+	// one token a second, the next is available within a second
+	std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+	CHECK_EQUAL(0, limit.tryAcquire(1, available));
+	CHECK(available > now);
+	CHECK(available <= now + std::chrono::milliseconds(1100));
+}
+
+TEST_CASE(rateLimitSmallerBurstCapsTokens)
+{
+	ServerRateLimit limit;
+	std::chrono::steady_clock::time_point available;
+
+	CHECK_EQUAL(EMailResult::Success, limit.setRatePerMinute(1));
+	CHECK_EQUAL(EMailResult::Success, limit.setBurst(3));
+	CHECK_EQUAL(3, limit.tryAcquire(5, available));
+	CHECK_EQUAL(0, limit.tryAcquire(1, available));
+}
+
+TEST_CASE(rateLimitRefillsAtRate)
+{
+	ServerRateLimit limit;
+	std::chrono::steady_clock::time_point available;
+
+	// a thousand tokens a second, the burst is full again well within 50ms
+	CHECK_EQUAL(EMailResult::Success, limit.setRatePerMinute(60000));
+	CHECK_EQUAL(EMailResult::Success, limit.setBurst(5));
+	CHECK_EQUAL(5, limit.tryAcquire(5, available));
+
+	std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+	CHECK_EQUAL(5, limit.tryAcquire(10, available));
+}
+
+TEST_CASE(rateLimitRefundReturnsTokens)
+{
+	ServerRateLimit limit;
+	std::chrono::steady_clock::time_point available;
+
+	CHECK_EQUAL(EMailResult::Success, limit.setRatePerMinute(1));
+	CHECK_EQUAL(EMailResult::Success, limit.setBurst(4));
+	CHECK_EQUAL(4, limit.tryAcquire(4, available));
+
+	limit.refund(2);
+
+	CHECK_EQUAL(2, limit.getSentToday());
+	CHECK_EQUAL(2, limit.tryAcquire(4, available));
+
+	// a refund never fills the bucket past the burst
+	limit.refund(10);
+	CHECK_EQUAL(4, limit.tryAcquire(10, available));
+}
+
+TEST_CASE(rateLimitDailyQuota)
+{
+	ServerRateLimit limit;
+	std::chrono::steady_clock::time_point available;
+
+	CHECK_EQUAL(EMailResult::Success, limit.setDailyQuota(3));
+	CHECK_EQUAL(3, limit.tryAcquire(5, available));
+
+	// nothing more until midnight UTC
+	std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+	CHECK_EQUAL(0, limit.tryAcquire(1, available));
+	CHECK(available > now);
+	CHECK(available <= now + std::chrono::hours(24));
+
+	limit.refund(1);
+	CHECK_EQUAL(1, limit.tryAcquire(5, available));
+	CHECK_EQUAL(3, limit.getSentToday());
+}
+
+TEST_CASE(rateLimitInvalidOptions)
+{
+	ServerRateLimit limit;
+
+	CHECK_EQUAL(EMailResult::InvalidOptionValue, limit.setBurst(0));
+	CHECK_EQUAL(EMailResult::InvalidOptionValue, limit.setRatePerMinute(-1));
+	CHECK_EQUAL(EMailResult::InvalidOptionValue, limit.setDailyQuota(-1));
+}
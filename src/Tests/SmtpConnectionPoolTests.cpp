@@ -0,0 +1,134 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+* MIT License
+*
+* Copyright (c) 2017 Simon Carter (s1cart3r@gmail.com)
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*
+* The Original Code was created by Simon Carter (s1cart3r@gmail.com).
+*
+* Module:  fbSMTPUDF - Firebird UDF Library for sending emails.
+*
+* Description: Unit tests for the pool of SMTP sessions shared by the send threads.
+*
+* Date: 17/10/2026
+*
+*/
+
+
+#include <thread>
+#include <chrono>
+
+#include "TestFramework.h"
+#include "FakeSmtpServer.h"
+#include "SmtpConnectionPool.h"
+
+using namespace FBMailUDF;
+using namespace FBMailUDFTests;
+
+static MailServerHandle poolServer(FakeSmtpServer &server)
+{
+	return (std::make_shared<const MailServer>(1, "127.0.0.1", server.getPort(), NO_SECURITY,
+		"user", "password", "test.fdb"));
+}
+
+static bool sendPooled(SmtpConnectionPool &pool, const MailServerHandle &server)
+{
+	CSmtp *mail = pool.acquire(server);
+	bool Result = true;
+
+	try
+	{
+		mail->SetSenderMail("sender@example.com");
+		mail->AddRecipient("recipient@example.com");
+		mail->SetSubject("pooled session");
+		mail->AddMsgLine("message text");
+		mail->Send();
+	}
+	catch (const ECSmtp &)
+	{
+		Result = false;
+	}
+
+	pool.release(server, mail);
+
+	return (Result);
+}
+
+TEST_CASE(poolReusesSessionAfterReset)
+{
+	FakeSmtpServer server(false);
+	MailServerHandle mailServer = poolServer(server);
+	SmtpConnectionPool pool;
+
+	CHECK(sendPooled(pool, mailServer));
+	CHECK(sendPooled(pool, mailServer));
+	CHECK(sendPooled(pool, mailServer));
+
+	// one session is used for every message, each reuse starts with RSET
+	CHECK_EQUAL(1, server.getConnectionCount());
+	CHECK_EQUAL(3, server.getMessageCount());
+	CHECK_EQUAL(2, server.getCommandCount("RSET"));
+	CHECK_EQUAL(1, server.getCommandCount("EHLO"));
+
+	pool.clear();
+}
+
+TEST_CASE(poolReplacesSessionClosedByServer)
+{
+	FakeSmtpServer server(false);
+	MailServerHandle mailServer = poolServer(server);
+	SmtpConnectionPool pool;
+
+	server.setCloseAfterMessage(true);
+	CHECK(sendPooled(pool, mailServer));
+
+	// the server drops the idle session, the pool notices before sending RSET and
+	// connects a new session rather than failing the message
+	std::this_thread::sleep_for(std::chrono::milliseconds(200));
+	server.setCloseAfterMessage(false);
+	CHECK(sendPooled(pool, mailServer));
+
+	CHECK_EQUAL(2, server.getConnectionCount());
+	CHECK_EQUAL(2, server.getMessageCount());
+	CHECK_EQUAL(0, server.getCommandCount("RSET"));
+
+	pool.clear();
+}
+
+TEST_CASE(poolKeepsSessionsForEachServer)
+{
+	FakeSmtpServer first(false);
+	FakeSmtpServer second(false);
+	MailServerHandle firstServer = poolServer(first);
+	MailServerHandle secondServer = poolServer(second);
+	SmtpConnectionPool pool;
+
+	CHECK(sendPooled(pool, firstServer));
+	CHECK(sendPooled(pool, secondServer));
+	CHECK(sendPooled(pool, firstServer));
+	CHECK(sendPooled(pool, secondServer));
+
+	CHECK_EQUAL(1, first.getConnectionCount());
+	CHECK_EQUAL(1, second.getConnectionCount());
+	CHECK_EQUAL(2, first.getMessageCount());
+	CHECK_EQUAL(2, second.getMessageCount());
+
+	pool.clear();
+}
@@ -0,0 +1,74 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+* MIT License
+*
+* Copyright (c) 2017 Simon Carter (s1cart3r@gmail.com)
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*
+* The Original Code was created by Simon Carter (s1cart3r@gmail.com).
+*
+* Module:  fbSMTPUDF - Firebird UDF Library for sending emails.
+*
+* Description: Minimal test registration and checks for the unit tests.
+*
+* Date: 17/10/2026
+*
+*/
+
+
+#ifndef FB_SMTP__TEST_FRAMEWORK
+#define FB_SMTP__TEST_FRAMEWORK
+
+#include <vector>
+
+namespace FBMailUDFTests
+{
+	typedef void(*TestFunction)();
+
+	struct TestCase
+	{
+		const char *name;
+		TestFunction function;
+	};
+
+	// tests register themselves when the program starts, they are run in the order
+	// they were registered
+	std::vector<TestCase> &getTestCases();
+
+	class TestRegistration
+	{
+	public:
+		TestRegistration(const char *name, TestFunction function);
+	};
+
+	void checkFailed(const char *fileName, const int line, const char *expression);
+}
+
+#define TEST_CASE(name) \
+	static void name(); \
+	static FBMailUDFTests::TestRegistration name##Registration(#name, name); \
+	static void name()
+
+// a failed check is reported and the test carries on, so every failure is shown
+#define CHECK(expression) \
+	((expression) ? (void)0 : FBMailUDFTests::checkFailed(__FILE__, __LINE__, #expression))
+
+#define CHECK_EQUAL(expected, actual) CHECK((expected) == (actual))
+
+#endif
@@ -0,0 +1,82 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+* MIT License
+*
+* Copyright (c) 2017 Simon Carter (s1cart3r@gmail.com)
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*
+* The Original Code was created by Simon Carter (s1cart3r@gmail.com).
+*
+* Module:  fbSMTPUDF - Firebird UDF Library for sending emails.
+*
+* Description: Runs every registered unit test, returns the number of failed checks.
+*
+* Date: 17/10/2026
+*
+*/
+
+
+#include <iostream>
+
+#include "TestFramework.h"
+
+namespace FBMailUDFTests
+{
+	int failedChecks = 0;
+
+	std::vector<TestCase> &getTestCases()
+	{
+		static std::vector<TestCase> testCases;
+		return (testCases);
+	}
+
+	TestRegistration::TestRegistration(const char *name, TestFunction function)
+	{
+		getTestCases().push_back({ name, function });
+	}
+
+	void checkFailed(const char *fileName, const int line, const char *expression)
+	{
+		failedChecks++;
+		std::cout << fileName << "(" << line << "): check failed: " << expression << std::endl;
+	}
+}
+
+int main()
+{
+	using namespace FBMailUDFTests;
+
+	int failedTests = 0;
+
+	for (const TestCase &testCase : getTestCases())
+	{
+		int failedBefore = failedChecks;
+		testCase.function();
+
+		if (failedChecks != failedBefore)
+		{
+			failedTests++;
+			std::cout << "FAILED " << testCase.name << std::endl;
+		}
+	}
+
+	std::cout << getTestCases().size() - failedTests << " of " << getTestCases().size() << " tests passed" << std::endl;
+
+	return (failedChecks);
+}
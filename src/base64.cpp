@@ -23,105 +23,338 @@
 
    Ren Nyffenegger rene.nyffenegger@adp-gmbh.ch
 
+   ALTERED SOURCE VERSION, this is not the original source code:
+
+     Simon Carter 2026-10-17
+     > Encoding and decoding use lookup tables instead of searching the
+       alphabet for each character and appending one character at a time.
+     > Added base64_encode_to which encodes into a caller supplied buffer and
+       optionally ends each line with a CRLF, for MIME content.
+     > Blocks of 12 (SSSE3) or 24 (AVX2) bytes are encoded, and blocks of 16
+       characters decoded (SSSE3), with vector instructions when the processor
+       supports them, the instruction set is chosen the first time it is used.
+
 */
 
 #include "base64.h"
-#include <iostream>
+#include "CpuFeatures.h"
+
+#ifdef FB_SMTP_X86
+  #include <immintrin.h>
+#endif
 
-static const std::string base64_chars = 
+using FBMailUDF::CpuFeatures;
+
+static const char base64_chars[] = 
              "ABCDEFGHIJKLMNOPQRSTUVWXYZ"
              "abcdefghijklmnopqrstuvwxyz"
              "0123456789+/";
 
+static const unsigned char BASE64_INVALID = 0xff;
+
+typedef size_t (*EncodeBlocks)(const unsigned char* in, size_t in_len, char* out);
+typedef size_t (*DecodeBlocks)(const char* in, size_t in_len, unsigned char* out, size_t& out_len);
+
+struct DecodeTable
+{
+  unsigned char values[256];
+
+  DecodeTable()
+  {
+    for (int i = 0; i < 256; i++)
+      values[i] = BASE64_INVALID;
+
+    for (int i = 0; i < 64; i++)
+      values[static_cast<unsigned char>(base64_chars[i])] = static_cast<unsigned char>(i);
+  }
+};
+
+static const DecodeTable decode_table;
 
-static inline bool is_base64(unsigned char c) 
+// encodes in_len bytes, padding the last group with '=' when in_len is not a multiple of 3
+static size_t encode_scalar(const unsigned char* in, size_t in_len, char* out)
 {
-  return (isalnum(c) || (c == '+') || (c == '/'));
+  char* start = out;
+  size_t i = 0;
+
+  for (; i + 3 <= in_len; i += 3)
+  {
+    unsigned int triple = (in[i] << 16) | (in[i + 1] << 8) | in[i + 2];
+
+    out[0] = base64_chars[triple >> 18];
+    out[1] = base64_chars[(triple >> 12) & 0x3f];
+    out[2] = base64_chars[(triple >> 6) & 0x3f];
+    out[3] = base64_chars[triple & 0x3f];
+    out += 4;
+  }
+
+  if (i < in_len)
+  {
+    unsigned int triple = in[i] << 16;
+
+    if (i + 1 < in_len)
+      triple |= in[i + 1] << 8;
+
+    out[0] = base64_chars[triple >> 18];
+    out[1] = base64_chars[(triple >> 12) & 0x3f];
+    out[2] = i + 1 < in_len ? base64_chars[(triple >> 6) & 0x3f] : '=';
+    out[3] = '=';
+    out += 4;
+  }
+
+  return (out - start);
 }
 
-std::string base64_encode(unsigned char const* bytes_to_encode, unsigned int in_len) 
+// decodes whole groups of 4 characters, stopping at padding or the first character which
+// is not part of the alphabet, used returns the number of characters decoded
+static size_t decode_scalar(const char* in, size_t in_len, unsigned char* out, size_t& used)
 {
-  std::string ret;
-  int i = 0, j = 0;
-  unsigned char char_array_3[3], char_array_4[4];
-
-  while (in_len--)
-	{
-    char_array_3[i++] = *(bytes_to_encode++);
-    if (i == 3) 
-		{
-      char_array_4[0] = (char_array_3[0] & 0xfc) >> 2;
-      char_array_4[1] = ((char_array_3[0] & 0x03) << 4) + ((char_array_3[1] & 0xf0) >> 4);
-      char_array_4[2] = ((char_array_3[1] & 0x0f) << 2) + ((char_array_3[2] & 0xc0) >> 6);
-      char_array_4[3] = char_array_3[2] & 0x3f;
-
-      for(i = 0; (i <4) ; i++)
-        ret += base64_chars[char_array_4[i]];
-      i = 0;
-    }
+  const unsigned char* values = decode_table.values;
+  unsigned char* start = out;
+  size_t i = 0;
+
+  for (; i + 4 <= in_len; i += 4)
+  {
+    unsigned int a = values[static_cast<unsigned char>(in[i])];
+    unsigned int b = values[static_cast<unsigned char>(in[i + 1])];
+    unsigned int c = values[static_cast<unsigned char>(in[i + 2])];
+    unsigned int d = values[static_cast<unsigned char>(in[i + 3])];
+
+    if ((a | b | c | d) & 0x80)
+      break;
+
+    unsigned int triple = (a << 18) | (b << 12) | (c << 6) | d;
+    out[0] = static_cast<unsigned char>(triple >> 16);
+    out[1] = static_cast<unsigned char>(triple >> 8);
+    out[2] = static_cast<unsigned char>(triple);
+    out += 3;
   }
 
-  if (i)
+  used = i;
+  return (out - start);
+}
+
+#ifdef FB_SMTP_X86
+
+// spreads each 3 bytes over 4 bytes holding 6 bits each, then adds the offset
+// from the 6 bit value to its character in the alphabet
+
+FB_SMTP_TARGET("ssse3")
+static inline __m128i encode_translate(__m128i indices)
+{
+  const __m128i offsets = _mm_setr_epi8(65, 71, -4, -4, -4, -4, -4, -4, -4, -4, -4, -4, -19, -16, 0, 0);
+  __m128i range = _mm_subs_epu8(indices, _mm_set1_epi8(51));
+  range = _mm_sub_epi8(range, _mm_cmpgt_epi8(indices, _mm_set1_epi8(25)));
+  return (_mm_add_epi8(indices, _mm_shuffle_epi8(offsets, range)));
+}
+
+FB_SMTP_TARGET("ssse3")
+static inline __m128i encode_unpack(__m128i input)
+{
+  input = _mm_shuffle_epi8(input, _mm_set_epi8(10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4, 1, 2, 0, 1));
+  const __m128i high = _mm_mulhi_epu16(_mm_and_si128(input, _mm_set1_epi32(0x0fc0fc00)), 
+    _mm_set1_epi32(0x04000040));
+  const __m128i low = _mm_mullo_epi16(_mm_and_si128(input, _mm_set1_epi32(0x003f03f0)), 
+    _mm_set1_epi32(0x01000010));
+  return (_mm_or_si128(high, low));
+}
+
+FB_SMTP_TARGET("ssse3")
+static size_t encode_ssse3(const unsigned char* in, size_t in_len, char* out)
+{
+  size_t i = 0;
+  size_t written = 0;
+
+  // each block reads 16 bytes but only encodes 12 of them
+  for (; i + 16 <= in_len; i += 12, written += 16)
   {
-    for(j = i; j < 3; j++)
-      char_array_3[j] = '\0';
+    __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(out + written), encode_translate(encode_unpack(block)));
+  }
 
-    char_array_4[0] = (char_array_3[0] & 0xfc) >> 2;
-    char_array_4[1] = ((char_array_3[0] & 0x03) << 4) + ((char_array_3[1] & 0xf0) >> 4);
-    char_array_4[2] = ((char_array_3[1] & 0x0f) << 2) + ((char_array_3[2] & 0xc0) >> 6);
-    char_array_4[3] = char_array_3[2] & 0x3f;
+  return (written + encode_scalar(in + i, in_len - i, out + written));
+}
 
-    for (j = 0; (j < i + 1); j++)
-      ret += base64_chars[char_array_4[j]];
+FB_SMTP_TARGET("avx2")
+static size_t encode_avx2(const unsigned char* in, size_t in_len, char* out)
+{
+  const __m256i shuffle = _mm256_setr_epi8(1, 0, 2, 1, 4, 3, 5, 4, 7, 6, 8, 7, 10, 9, 11, 10, 
+    1, 0, 2, 1, 4, 3, 5, 4, 7, 6, 8, 7, 10, 9, 11, 10);
+  const __m256i offsets = _mm256_setr_epi8(65, 71, -4, -4, -4, -4, -4, -4, -4, -4, -4, -4, -19, -16, 0, 0,
+    65, 71, -4, -4, -4, -4, -4, -4, -4, -4, -4, -4, -19, -16, 0, 0);
+  size_t i = 0;
+  size_t written = 0;
+
+  // each half of the register encodes 12 bytes, the second half is loaded from 12 bytes
+  // on so the block reads 28 bytes
+  for (; i + 28 <= in_len; i += 24, written += 32)
+  {
+    __m256i block = _mm256_inserti128_si256(_mm256_castsi128_si256(
+      _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i))),
+      _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i + 12)), 1);
+    block = _mm256_shuffle_epi8(block, shuffle);
 
-    while((i++ < 3))
-      ret += '=';
+    const __m256i high = _mm256_mulhi_epu16(_mm256_and_si256(block, _mm256_set1_epi32(0x0fc0fc00)), 
+      _mm256_set1_epi32(0x04000040));
+    const __m256i low = _mm256_mullo_epi16(_mm256_and_si256(block, _mm256_set1_epi32(0x003f03f0)), 
+      _mm256_set1_epi32(0x01000010));
+    const __m256i indices = _mm256_or_si256(high, low);
 
+    __m256i range = _mm256_subs_epu8(indices, _mm256_set1_epi8(51));
+    range = _mm256_sub_epi8(range, _mm256_cmpgt_epi8(indices, _mm256_set1_epi8(25)));
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + written), 
+      _mm256_add_epi8(indices, _mm256_shuffle_epi8(offsets, range)));
   }
 
-  return ret;
+  return (written + encode_ssse3(in + i, in_len - i, out + written));
+}
 
+// classifies each character by its high and low nibble, any character outside the
+// alphabet sends the rest of the input to the scalar decoder which stops at it
+FB_SMTP_TARGET("ssse3")
+static size_t decode_ssse3(const char* in, size_t in_len, unsigned char* out, size_t& used)
+{
+  const __m128i lut_lo = _mm_setr_epi8(0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11,
+    0x11, 0x11, 0x13, 0x1a, 0x1b, 0x1b, 0x1b, 0x1a);
+  const __m128i lut_hi = _mm_setr_epi8(0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08,
+    0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10);
+  const __m128i lut_roll = _mm_setr_epi8(0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0);
+  const __m128i pack = _mm_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1);
+  size_t i = 0;
+  size_t written = 0;
+
+  // each block stores 16 bytes but only 12 of them are decoded
+  for (; i + 16 <= in_len; i += 16, written += 12)
+  {
+    __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i));
+    const __m128i hi_nibbles = _mm_and_si128(_mm_srli_epi32(block, 4), _mm_set1_epi8(0x0f));
+    const __m128i lo_nibbles = _mm_and_si128(block, _mm_set1_epi8(0x0f));
+
+    const __m128i invalid = _mm_and_si128(_mm_shuffle_epi8(lut_lo, lo_nibbles), 
+      _mm_shuffle_epi8(lut_hi, hi_nibbles));
+
+    if (_mm_movemask_epi8(_mm_cmpgt_epi8(invalid, _mm_setzero_si128())))
+      break;
+
+    const __m128i roll = _mm_shuffle_epi8(lut_roll, 
+      _mm_add_epi8(_mm_cmpeq_epi8(block, _mm_set1_epi8('/')), hi_nibbles));
+    block = _mm_add_epi8(block, roll);
+
+    block = _mm_maddubs_epi16(block, _mm_set1_epi32(0x01400140));
+    block = _mm_madd_epi16(block, _mm_set1_epi32(0x00011000));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(out + written), _mm_shuffle_epi8(block, pack));
+  }
+
+  size_t remaining;
+  written += decode_scalar(in + i, in_len - i, out + written, remaining);
+  used = i + remaining;
+  return (written);
 }
+#endif
 
-std::string base64_decode(std::string const& encoded_string) 
+static EncodeBlocks get_encoder()
 {
-  int in_len = encoded_string.size();
-  int i = 0, j = 0, in_ = 0;
-  unsigned char char_array_4[4], char_array_3[3];
-  std::string ret;
-
-  while (in_len-- && ( encoded_string[in_] != '=') && is_base64(encoded_string[in_])) 
-	{
-    char_array_4[i++] = encoded_string[in_]; in_++;
-    if (i ==4) {
-      for (i = 0; i <4; i++)
-        char_array_4[i] = base64_chars.find(char_array_4[i]);
-
-      char_array_3[0] = (char_array_4[0] << 2) + ((char_array_4[1] & 0x30) >> 4);
-      char_array_3[1] = ((char_array_4[1] & 0xf) << 4) + ((char_array_4[2] & 0x3c) >> 2);
-      char_array_3[2] = ((char_array_4[2] & 0x3) << 6) + char_array_4[3];
-
-      for (i = 0; (i < 3); i++)
-        ret += char_array_3[i];
-      i = 0;
-    }
+#ifdef FB_SMTP_X86
+  if (CpuFeatures::hasAVX2())
+    return (encode_avx2);
+
+  if (CpuFeatures::hasSSSE3())
+    return (encode_ssse3);
+#endif
+  return (encode_scalar);
+}
+
+static DecodeBlocks get_decoder()
+{
+#ifdef FB_SMTP_X86
+  if (CpuFeatures::hasSSSE3())
+    return (decode_ssse3);
+#endif
+  return (decode_scalar);
+}
+
+size_t base64_encoded_size(size_t len, size_t line_length)
+{
+  size_t Result = (len + 2) / 3 * 4;
+  size_t line_bytes = line_length / 4 * 3;
+
+  if (line_bytes && len)
+    Result += (len + line_bytes - 1) / line_bytes * 2;
+
+  return (Result);
+}
+
+size_t base64_encode_to(unsigned char const* bytes_to_encode, size_t in_len, char* out, size_t line_length)
+{
+  static const EncodeBlocks encode = get_encoder();
+  size_t line_bytes = line_length / 4 * 3;
+
+  if (line_bytes == 0)
+    return (encode(bytes_to_encode, in_len, out));
+
+  char* start = out;
+
+  while (in_len)
+  {
+    size_t line = in_len < line_bytes ? in_len : line_bytes;
+
+    out += encode(bytes_to_encode, line, out);
+    *out++ = '\r';
+    *out++ = '\n';
+
+    bytes_to_encode += line;
+    in_len -= line;
   }
 
-  if (i) 
-	{
-    for (j = i; j <4; j++)
-      char_array_4[j] = 0;
+  return (out - start);
+}
+
+std::string base64_encode(unsigned char const* bytes_to_encode, unsigned int in_len) 
+{
+  std::string ret(base64_encoded_size(in_len, 0), '\0');
+
+  if (in_len)
+    base64_encode_to(bytes_to_encode, in_len, &ret[0], 0);
 
-    for (j = 0; j <4; j++)
-      char_array_4[j] = base64_chars.find(char_array_4[j]);
+  return ret;
+}
 
-    char_array_3[0] = (char_array_4[0] << 2) + ((char_array_4[1] & 0x30) >> 4);
-    char_array_3[1] = ((char_array_4[1] & 0xf) << 4) + ((char_array_4[2] & 0x3c) >> 2);
-    char_array_3[2] = ((char_array_4[2] & 0x3) << 6) + char_array_4[3];
+std::string base64_decode(std::string const& encoded_string) 
+{
+  static const DecodeBlocks decode = get_decoder();
+  const unsigned char* values = decode_table.values;
+  size_t in_len = encoded_string.size();
+  size_t used = 0;
+
+  // the vector decoder stores 4 bytes more than it decodes
+  std::string ret(in_len / 4 * 3 + 4, '\0');
+  size_t out_len = decode(encoded_string.data(), in_len, reinterpret_cast<unsigned char*>(&ret[0]), used);
+
+  // the decoders stop before a group which is incomplete or holds padding, the 2 or 3
+  // characters at the start of the group decode to 1 or 2 bytes
+  unsigned int group = 0;
+  size_t count = 0;
+
+  while (used < in_len)
+  {
+    unsigned char value = values[static_cast<unsigned char>(encoded_string[used++])];
+
+    if (value == BASE64_INVALID)
+      break;
+
+    group = (group << 6) | value;
+    count++;
+  }
+
+  if (count >= 2)
+  {
+    group <<= 6 * (4 - count);
+    ret[out_len++] = static_cast<char>(group >> 16);
 
-    for (j = 0; (j < i - 1); j++) 
-			ret += char_array_3[j];
+    if (count == 3)
+      ret[out_len++] = static_cast<char>(group >> 8);
   }
 
+  ret.resize(out_len);
   return ret;
 }
@@ -1,4 +1,5 @@
 #include <string>
+#include <stddef.h>
 
 #ifndef _BASE64_H_
 #define _BASE64_H_
@@ -7,7 +8,20 @@
 #pragma warning(disable:4267)
 #endif
 
+// characters in a line of base64 encoded MIME content, not including the CRLF
+#define BASE64_MIME_LINE_LENGTH 76
+
 std::string base64_encode(unsigned char const* , unsigned int len);
 std::string base64_decode(std::string const& s);
 
-#endif
\ No newline at end of file
+// number of characters base64_encode_to writes for len bytes, including the
+// CRLF ending each line when line_length is not 0
+size_t base64_encoded_size(size_t len, size_t line_length);
+
+// encodes len bytes into out, which must hold base64_encoded_size(len, line_length)
+// characters, every line_length characters (rounded down to a multiple of 4) are 
+// followed by a CRLF, as is the last line, a line_length of 0 writes a single line
+// without a CRLF. Returns the number of characters written, out is not terminated
+size_t base64_encode_to(unsigned char const* bytes_to_encode, size_t in_len, char* out, size_t line_length);
+
+#endif
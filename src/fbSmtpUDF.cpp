@@ -94,7 +94,7 @@ FBUDF_API int fbSMTPMessageSend(const FB_BIGINT &serverID, const FB_BIGINT &id,
 		return FBMailUDF::__messageServerInstance.sendMessage(serverID, id,	senderName ? std::string(senderName) : "",
 			senderEmail ? std::string(senderEmail) : "", recipient ? std::string(recipient) : "",
 			recipient ? std::string(recipient) : "", subject ? std::string(subject) : "", 
-			message ? std::string(message) : "", priority, sendImmediate != 0);
+			message ? std::string(message) : "", priority, sendImmediate != 0, 0);
 	}
 	catch (...)
 	{
@@ -111,7 +111,24 @@ FBUDF_API int fbSMTPMessageSendEx(const FB_BIGINT &serverID, const FB_BIGINT &id
 		return FBMailUDF::__messageServerInstance.sendMessage(serverID, id, senderName ? std::string(senderName) : "",
 			senderEmail ? std::string(senderEmail) : "", recipientName ? std::string(recipientName) : "",
 			recipientEmail ? std::string(recipientEmail): "", subject ? std::string(subject) : "", 
-			message ? std::string(message) : "", priority, sendImmediate != 0);
+			message ? std::string(message) : "", priority, sendImmediate != 0, 0);
+	}
+	catch (...)
+	{
+		return FBMailUDF::EMailResult::GeneralError;
+	}
+}
+
+FBUDF_API int fbSMTPMessageSendDeadline(const FB_BIGINT &serverID, const FB_BIGINT &id, const int &priority,
+	const int &deadline, const char *senderName, const char *senderEmail, const char *recipientName,
+	const char *recipientEmail, const char *subject, const char *message)
+{
+	try
+	{
+		return FBMailUDF::__messageServerInstance.sendMessage(serverID, id, senderName ? std::string(senderName) : "",
+			senderEmail ? std::string(senderEmail) : "", recipientName ? std::string(recipientName) : "",
+			recipientEmail ? std::string(recipientEmail): "", subject ? std::string(subject) : "", 
+			message ? std::string(message) : "", priority, false, deadline);
 	}
 	catch (...)
 	{
@@ -180,3 +197,51 @@ FBUDF_API int fbSMTPMessageCount(const char *database, const int &cancelAll, con
 		return FBMailUDF::EMailResult::GeneralError;
 	}
 }
+
+FBUDF_API FB_BIGINT fbSMTPStatistic(const int &statistic)
+{
+	try
+	{
+		return FBMailUDF::__messageServerInstance.statistic(statistic);
+	}
+	catch (...)
+	{
+		return FBMailUDF::EMailResult::GeneralError;
+	}
+}
+
+FBUDF_API int fbSMTPSetOption(const int &option, const int &value)
+{
+	try
+	{
+		return FBMailUDF::__messageServerInstance.setOption(option, value);
+	}
+	catch (...)
+	{
+		return FBMailUDF::EMailResult::GeneralError;
+	}
+}
+
+FBUDF_API int fbSMTPServerOption(const FB_BIGINT &serverID, const int &option, const int &value)
+{
+	try
+	{
+		return FBMailUDF::__messageServerInstance.setServerOption(serverID, option, value);
+	}
+	catch (...)
+	{
+		return FBMailUDF::EMailResult::GeneralError;
+	}
+}
+
+FBUDF_API int fbSMTPDatabaseWeight(const char *database, const int &weight)
+{
+	try
+	{
+		return FBMailUDF::__messageServerInstance.setDatabaseWeight(database ? std::string(database) : "", weight);
+	}
+	catch (...)
+	{
+		return FBMailUDF::EMailResult::GeneralError;
+	}
+}
@@ -53,9 +53,21 @@ extern "C"
 		const int &sendImmediate, const char *senderName, const char *senderEmail, const char *recipientName,
 		const char *recipientEmail, const char *subject, const char *message);
 
+	FBUDF_API int fbSMTPMessageSendDeadline(const FB_BIGINT &serverID, const FB_BIGINT &id, const int &priority,
+		const int &deadline, const char *senderName, const char *senderEmail, const char *recipientName,
+		const char *recipientEmail, const char *subject, const char *message);
+
 	FBUDF_API int fbSMTPMessageResult(const FB_BIGINT &serverID, const FB_BIGINT &emailID, const int &eraseMessage);
 
 	FBUDF_API int fbSMTPMessageResultText(const FB_BIGINT &serverID, const FB_BIGINT &emailID, char *message);
 
 	FBUDF_API int fbSMTPMessageCount(const char *database, const int &cancelAll, const int &sleep);
+
+	FBUDF_API FB_BIGINT fbSMTPStatistic(const int &statistic);
+
+	FBUDF_API int fbSMTPSetOption(const int &option, const int &value);
+
+	FBUDF_API int fbSMTPServerOption(const FB_BIGINT &serverID, const int &option, const int &value);
+
+	FBUDF_API int fbSMTPDatabaseWeight(const char *database, const int &weight);
 }